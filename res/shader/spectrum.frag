@@ -6,13 +6,14 @@ out vec4 fragColor;
 
 uniform sampler1DArray wfall;
 uniform float wrapPos;
+uniform float layerOffset;
 uniform float width;
 
-const float lo = -100.0f;
-const float hi = -20.0;
+uniform float lo;
+uniform float hi;
 
 float getY(float x) {
-    float dB = texture(wfall, vec2(x, wrapPos)).r;
+    float dB = texture(wfall, vec2(x, layerOffset + wrapPos)).r;
     float scaled = (dB - lo) / (hi - lo);
 
     return scaled;
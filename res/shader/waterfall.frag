@@ -7,17 +7,19 @@ out vec4 fragColor;
 uniform sampler1DArray wfall;
 uniform sampler1D cmap;
 uniform float wrapPos;
+uniform float layerOffset;
 uniform float histLen;
 uniform float wfallHeight;
 
-const float lo = -100.0f;
-const float hi = -20.0f;
+uniform float lo;
+uniform float hi;
 
 vec3 waterfall(vec2 pos)
 {
     float dt = (1.0 - pos.y) * wfallHeight;
     float t = mod(wrapPos - dt + histLen, histLen);
-    float a = texture(wfall, vec2(pos.x, t + 0.5)).r;
+    // Stay within the layers of this lane.
+    float a = texture(wfall, vec2(pos.x, layerOffset + min(t + 0.5, histLen - 1.0))).r;
 
     float c = clamp((a - lo) / (hi - lo), 0.0f, 1.0f);
 
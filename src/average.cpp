@@ -0,0 +1,109 @@
+#include "average.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+AverageMode parse_average_mode(const std::string& name)
+{
+    if (name == "none") {
+        return AverageMode::None;
+    } else if (name == "linear") {
+        return AverageMode::Linear;
+    } else if (name == "exp") {
+        return AverageMode::Exponential;
+    } else if (name == "max") {
+        return AverageMode::Max;
+    } else if (name == "min") {
+        return AverageMode::Min;
+    }
+
+    throw std::invalid_argument("Unknown averaging mode: " + name);
+}
+
+Averager::Averager(AverageMode mode, std::size_t count, float alpha)
+    : _mode(mode), _count(mode == AverageMode::None ? 1 : count), _alpha(alpha)
+{
+    if (count == 0) {
+        throw std::invalid_argument("At least one frame must be averaged");
+    }
+
+    if (alpha <= 0.0f || alpha > 1.0f) {
+        throw std::invalid_argument("The averaging weight must be in (0, 1]");
+    }
+}
+
+AverageMode Averager::mode() const
+{
+    return _mode;
+}
+
+std::size_t Averager::count() const
+{
+    return _count;
+}
+
+bool Averager::add(std::span<const float> power)
+{
+    const std::size_t n = power.size();
+    const float* in = power.data();
+
+    if (_acc.size() != n) {
+        _added = 0;
+        _primed = false;
+    }
+
+    // The first spectrum of a block (or of the exponential average)
+    // is copied, the loops below are kept simple so that they vectorize.
+    bool first = _mode == AverageMode::Exponential ? !_primed : _added == 0;
+    if (first) {
+        _acc.assign(power.begin(), power.end());
+        _primed = true;
+    } else {
+        float* acc = _acc.data();
+        switch (_mode) {
+            case AverageMode::None:
+            case AverageMode::Linear:
+                for (std::size_t i = 0; i < n; i++) {
+                    acc[i] += in[i];
+                }
+                break;
+            case AverageMode::Exponential: {
+                const float alpha = _alpha;
+                for (std::size_t i = 0; i < n; i++) {
+                    acc[i] += alpha * (in[i] - acc[i]);
+                }
+                break;
+            }
+            case AverageMode::Max:
+                for (std::size_t i = 0; i < n; i++) {
+                    acc[i] = in[i] > acc[i] ? in[i] : acc[i];
+                }
+                break;
+            case AverageMode::Min:
+                for (std::size_t i = 0; i < n; i++) {
+                    acc[i] = in[i] < acc[i] ? in[i] : acc[i];
+                }
+                break;
+        }
+    }
+
+    if (++_added < _count) {
+        return false;
+    }
+
+    if (_mode == AverageMode::Linear && _count > 1) {
+        const float norm = 1.0f / _count;
+        for (float& x : _acc) {
+            x *= norm;
+        }
+    }
+
+    _added = 0;
+
+    return true;
+}
+
+std::span<const float> Averager::result() const
+{
+    return _acc;
+}
@@ -0,0 +1,71 @@
+#ifndef WFALL_AVERAGE_H
+#define WFALL_AVERAGE_H
+
+#include <vector>
+#include <string>
+#include <span>
+
+/**
+ * How consecutive power spectra are combined.
+ */
+enum class AverageMode {
+    /** Every spectrum is passed on unchanged. */
+    None,
+    /** The mean power of each block of frames. */
+    Linear,
+    /** An exponential moving average, sampled once per block. */
+    Exponential,
+    /** The highest power of each bin in the block. */
+    Max,
+    /** The lowest power of each bin in the block. */
+    Min,
+};
+
+/**
+ * Parses an averaging mode name ("none", "linear", "exp", "max" or
+ * "min").
+ *
+ * Throws std::invalid_argument for unknown names.
+ */
+AverageMode parse_average_mode(const std::string& name);
+
+/**
+ * Averages consecutive power spectra.
+ *
+ * The spectra are added one at a time, and every count() spectra an
+ * averaged spectrum is complete. The spectra must be added in order,
+ * since the exponential average depends on it.
+ */
+class Averager {
+    AverageMode _mode;
+    std::size_t _count;
+    float _alpha;
+    std::vector<float> _acc;
+    std::size_t _added = 0;
+    bool _primed = false;
+
+public:
+    /**
+     * ctor.
+     *
+     * Emits an average every count spectra. alpha is the weight of the
+     * newest spectrum in the exponential average.
+     */
+    Averager(AverageMode mode = AverageMode::None, std::size_t count = 1, float alpha = 0.25f);
+
+    AverageMode mode() const;
+    std::size_t count() const;
+
+    /**
+     * Adds a power spectrum. Returns true if an averaged spectrum is
+     * complete, which can then be read with result().
+     */
+    bool add(std::span<const float> power);
+
+    /**
+     * Returns the last complete average.
+     */
+    std::span<const float> result() const;
+};
+
+#endif /* WFALL_AVERAGE_H */
@@ -0,0 +1,98 @@
+#include "batch.h"
+
+#include <iostream>
+#include <cmath>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+
+OutputFormat output_format(const std::string& path)
+{
+    const std::string ext = ".npy";
+    if (path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0) {
+        return OutputFormat::Npy;
+    }
+
+    return OutputFormat::Raw;
+}
+
+SpectrogramWriter::SpectrogramWriter(const std::string& path, OutputFormat format,
+        std::size_t lanes, std::size_t bins)
+    : _out(&std::cout), _format(format), _lanes(lanes), _bins(bins), _row(lanes * bins)
+{
+    if (path == "-") {
+        if (format == OutputFormat::Npy) {
+            throw std::invalid_argument("NPY output needs a file");
+        }
+    } else {
+        _file.open(path, std::ios::binary | std::ios::trunc);
+        if (!_file) {
+            throw std::runtime_error("Could not open " + path + " for writing.");
+        }
+        _out = &_file;
+    }
+
+    if (_format == OutputFormat::Npy) {
+        write_header();
+    }
+}
+
+void SpectrogramWriter::write_header()
+{
+    std::string shape = std::to_string(_rows) + ", ";
+    if (_lanes > 1) {
+        shape += std::to_string(_lanes) + ", ";
+    }
+    shape += std::to_string(_bins);
+
+    const char* descr = std::endian::native == std::endian::little ? "<f4" : ">f4";
+    std::string dict = std::string("{'descr': '") + descr + "', 'fortran_order': False, 'shape': ("
+            + shape + "), }";
+
+    // Version 1.0: magic, version, little-endian header length, then the
+    // dict padded with spaces to the full size and ended by a newline.
+    const std::size_t prefix = 10;
+    const uint16_t length = NPY_HEADER_SIZE - prefix;
+    dict.resize(length - 1, ' ');
+    dict += '\n';
+
+    const char magic[prefix] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0,
+            char(length & 0xff), char(length >> 8)};
+    _out->write(magic, prefix);
+    _out->write(dict.data(), dict.size());
+}
+
+void SpectrogramWriter::write(const Frame& frame)
+{
+    if (frame.bins != _bins || frame.power.size() != _row.size()) {
+        throw std::runtime_error("The frame does not match the shape of the spectrogram");
+    }
+
+    for (std::size_t i = 0; i < _row.size(); i++) {
+        _row[i] = 10.0f * std::log10(frame.power[i]);
+    }
+
+    _out->write(reinterpret_cast<const char*>(_row.data()), _row.size() * sizeof(float));
+    if (!*_out) {
+        throw std::runtime_error("Could not write the spectrogram");
+    }
+    _rows++;
+}
+
+void SpectrogramWriter::finish()
+{
+    if (_format == OutputFormat::Npy) {
+        _out->seekp(0);
+        write_header();
+    }
+
+    _out->flush();
+    if (!*_out) {
+        throw std::runtime_error("Could not write the spectrogram");
+    }
+}
+
+std::size_t SpectrogramWriter::rows() const
+{
+    return _rows;
+}
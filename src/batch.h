@@ -0,0 +1,76 @@
+#ifndef WFALL_BATCH_H
+#define WFALL_BATCH_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "fftseq.h"
+
+/**
+ * The file formats that a spectrogram can be written in.
+ */
+enum class OutputFormat {
+    /** Headerless float32 in native byte order. */
+    Raw,
+    /** NumPy .npy, float32 with the shape in the header. */
+    Npy,
+};
+
+/**
+ * Returns Npy for paths that end in ".npy" and Raw otherwise.
+ */
+OutputFormat output_format(const std::string& path);
+
+/**
+ * Writes the frames of an FftSeq to a file as a spectrogram in dB, one
+ * row per frame, with the lanes of a frame one after another.
+ *
+ * The rows are streamed to the file as they come, so the memory used does
+ * not depend on the length of the input. An NPY header is written up front
+ * with room for any number of rows, and its shape is filled in by
+ * finish(), so NPY output needs a file that can be seeked. Raw output can
+ * also go to stdout, as "-".
+ */
+class SpectrogramWriter {
+    std::ofstream _file;
+    std::ostream* _out;
+    OutputFormat _format;
+    std::size_t _lanes;
+    std::size_t _bins;
+    std::size_t _rows = 0;
+    std::vector<float> _row;
+
+    /** Length of the NPY header, with room for the largest row count. */
+    static constexpr std::size_t NPY_HEADER_SIZE = 128;
+
+    void write_header();
+
+public:
+    /**
+     * ctor.
+     *
+     * Throws std::runtime_error if the file can not be opened, and
+     * std::invalid_argument for NPY output to stdout.
+     */
+    SpectrogramWriter(const std::string& path, OutputFormat format, std::size_t lanes,
+            std::size_t bins);
+
+    /**
+     * Appends the power spectra of frame, converted to dB.
+     *
+     * Throws std::runtime_error if the frame does not match the shape of
+     * the file or the write fails.
+     */
+    void write(const Frame& frame);
+
+    /**
+     * Flushes the rows and completes the header.
+     */
+    void finish();
+
+    std::size_t rows() const;
+};
+
+#endif /* WFALL_BATCH_H */
@@ -0,0 +1,220 @@
+#include "buffered.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+DropPolicy parse_drop_policy(const std::string& name)
+{
+    if (name == "block") {
+        return DropPolicy::Block;
+    } else if (name == "oldest") {
+        return DropPolicy::DropOldest;
+    } else if (name == "decimate") {
+        return DropPolicy::Decimate;
+    }
+
+    throw std::invalid_argument("Unknown drop policy: " + name);
+}
+
+BufferedStream::BufferedStream(Stream& source, std::size_t capacity, std::size_t chunk)
+    : _source(source), _chunk(std::min(chunk, capacity)),
+      _ring(capacity, source.lanes()),
+      _marks(2 * (capacity / _chunk) + 2) {}
+
+BufferedStream::~BufferedStream()
+{
+    _ring.close();
+    if (_reader.joinable()) {
+        _reader.join();
+    }
+}
+
+void BufferedStream::start()
+{
+    _reader = std::thread(&BufferedStream::reader_fn, this);
+}
+
+void BufferedStream::policy(DropPolicy policy)
+{
+    _policy = policy;
+}
+
+DropPolicy BufferedStream::policy() const
+{
+    return _policy;
+}
+
+OverrunStats BufferedStream::stats() const
+{
+    OverrunStats stats;
+    stats.samples_dropped = _samples_dropped.load();
+    stats.stalls = _stalls.load();
+    stats.high_water = _high_water.load();
+
+    return stats;
+}
+
+std::size_t BufferedStream::buffered() const
+{
+    return _ring.readable();
+}
+
+std::size_t BufferedStream::capacity() const
+{
+    return _ring.capacity();
+}
+
+std::size_t BufferedStream::lanes() const
+{
+    return _ring.lanes();
+}
+
+void BufferedStream::reader_fn()
+{
+    std::vector<OutSample*> ptrs(_ring.lanes());
+    std::vector<OutSample> scratch;
+
+    while (!_ring.closed()) {
+        if (_ring.writable() == 0) {
+            _stalls++;
+
+            // Decimate drops frames rather than samples, so that the
+            // positions of the frames stay exact.
+            if (_policy != DropPolicy::DropOldest) {
+                if (!_ring.wait_writable(1)) {
+                    break;
+                }
+            } else {
+                // Keep draining the source, the consumer drops the
+                // backlog once it gets going again.
+                scratch.resize(_chunk * _ring.lanes());
+                for (std::size_t l = 0; l < ptrs.size(); l++) {
+                    ptrs[l] = scratch.data() + l * _chunk;
+                }
+                _source.read(ptrs.data(), _chunk);
+                _samples_dropped += _chunk;
+                if (_source.eof()) {
+                    break;
+                }
+                continue;
+            }
+        }
+
+        std::size_t count = std::min(_chunk, _ring.write_contiguous());
+        for (std::size_t l = 0; l < ptrs.size(); l++) {
+            ptrs[l] = _ring.write_ptr(l);
+        }
+
+        _source.read(ptrs.data(), count);
+
+        // The mark is published first, so that it is there by the time
+        // the consumer sees the samples. If the consumer has fallen far
+        // behind the mark is dropped and the previous one is used.
+        if (_marks.writable() > 0) {
+            *_marks.write_ptr(0) = ArrivalMark{_ring.written() + count, _source.arrival()};
+            _marks.commit(1);
+        }
+        _ring.commit(count);
+
+        std::size_t level = _ring.readable();
+        if (level > _high_water.load(std::memory_order_relaxed)) {
+            _high_water = level;
+        }
+
+        if (_source.eof()) {
+            break;
+        }
+    }
+
+    // The consumer reads what is left and then sees the end.
+    _ring.close();
+}
+
+void BufferedStream::limit_backlog(std::size_t count)
+{
+    if (_policy == DropPolicy::Block) {
+        return;
+    }
+
+    std::size_t backlog = _ring.readable();
+    if (backlog <= _ring.capacity() / 2) {
+        return;
+    }
+
+    if (_policy == DropPolicy::DropOldest) {
+        // Keep just enough to serve this read.
+        std::size_t drop = backlog - std::min(backlog, count);
+        _ring.consume(drop);
+        _samples_dropped += drop;
+    }
+}
+
+void BufferedStream::update_arrival()
+{
+    // The newest consumed sample belongs to the first mark that ends
+    // after it. Marks that end before it are done with.
+    std::size_t consumed = _ring.consumed();
+    while (_marks.readable() > 0) {
+        ArrivalMark mark = *_marks.read_ptr(0);
+        _arrival = mark.time;
+        if (mark.end > consumed) {
+            break;
+        }
+
+        _marks.consume(1);
+        if (mark.end == consumed) {
+            break;
+        }
+    }
+}
+
+Stream::Clock::time_point BufferedStream::arrival() const
+{
+    return _arrival;
+}
+
+bool BufferedStream::behind() const
+{
+    return _policy == DropPolicy::Decimate && _ring.readable() > _ring.capacity() / 2;
+}
+
+bool BufferedStream::eof() const
+{
+    return _ring.closed() && _ring.readable() == 0;
+}
+
+void BufferedStream::read(OutSample* const* out, std::size_t count)
+{
+    limit_backlog(count);
+
+    std::size_t done = 0;
+    while (done < count) {
+        if (!_ring.wait_readable(1)) {
+            // The ring was closed, pad with silence.
+            for (std::size_t l = 0; l < _ring.lanes(); l++) {
+                std::fill(out[l] + done, out[l] + count, OutSample(0.0f));
+            }
+            return;
+        }
+
+        std::size_t n = std::min(count - done, _ring.read_contiguous());
+        for (std::size_t l = 0; l < _ring.lanes(); l++) {
+            std::copy_n(_ring.read_ptr(l), n, out[l] + done);
+        }
+        _ring.consume(n);
+        done += n;
+    }
+
+    update_arrival();
+}
+
+void BufferedStream::skip(std::size_t count)
+{
+    while (count > 0 && _ring.wait_readable(1)) {
+        std::size_t n = std::min(count, _ring.readable());
+        _ring.consume(n);
+        count -= n;
+    }
+
+    update_arrival();
+}
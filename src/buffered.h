@@ -0,0 +1,145 @@
+#ifndef WFALL_BUFFERED_H
+#define WFALL_BUFFERED_H
+
+#include <thread>
+#include <atomic>
+#include <string>
+
+#include "fftseq.h"
+#include "ring.h"
+
+/**
+ * What a BufferedStream does when the consumer falls behind.
+ *
+ * Block: the reader thread stops reading until there is room in the
+ * ring, which pushes the overrun upstream.
+ * DropOldest: the consumer discards the backlog and continues with the
+ * newest data.
+ * Decimate: the consumer skips every other frame until it has caught
+ * up, see Stream::behind. Whole frames are skipped, so the ones that are
+ * computed are not shifted.
+ */
+enum class DropPolicy {
+    Block,
+    DropOldest,
+    Decimate,
+};
+
+/**
+ * Parses a drop policy name ("block", "oldest" or "decimate").
+ *
+ * Throws std::invalid_argument for unknown names.
+ */
+DropPolicy parse_drop_policy(const std::string& name);
+
+/**
+ * Overrun accounting of a BufferedStream.
+ */
+struct OverrunStats {
+    /** Samples thrown away because the consumer was behind. */
+    std::size_t samples_dropped = 0;
+    /** Times the reader found the ring full. */
+    std::size_t stalls = 0;
+    /** Highest number of frames buffered at once. */
+    std::size_t high_water = 0;
+};
+
+/**
+ * Reads a Stream on a dedicated thread.
+ *
+ * The reader thread continuously decodes the source stream in chunks
+ * into a lock-free ring, so that the input is drained while the consumer
+ * is busy computing FFTs or waiting for the display. Reads from the
+ * BufferedStream are served from the ring.
+ *
+ * The reader thread is started by start() and stops when the source
+ * ends or the BufferedStream is destroyed.
+ *
+ * With DropPolicy::DropOldest the backlog is kept below half the
+ * capacity, which bounds the latency, and the reader discards input
+ * rather than waiting if the ring fills up. With DropPolicy::Decimate the
+ * consumer is told to skip frames instead, and no samples are dropped.
+ */
+class BufferedStream : public Stream {
+    /**
+     * The arrival time of the samples written before end.
+     */
+    struct ArrivalMark {
+        std::size_t end = 0;
+        Clock::time_point time;
+    };
+
+    Stream& _source;
+    std::size_t _chunk;
+    SpscRing<OutSample> _ring;
+    SpscRing<ArrivalMark> _marks;
+    Clock::time_point _arrival = Clock::now();
+    std::thread _reader;
+    DropPolicy _policy = DropPolicy::Block;
+
+    std::atomic<std::size_t> _samples_dropped = 0;
+    std::atomic<std::size_t> _stalls = 0;
+    std::atomic<std::size_t> _high_water = 0;
+
+    /**
+     * Discards old data if the backlog is too long, according to the
+     * policy. count is the size of the read that is about to be made.
+     */
+    void limit_backlog(std::size_t count);
+
+    /**
+     * Updates _arrival from the marks of the samples consumed so far.
+     */
+    void update_arrival();
+
+    void reader_fn();
+
+public:
+    /**
+     * ctor.
+     *
+     * capacity is the number of frames that can be buffered and chunk
+     * is the number of frames read from the source at a time.
+     */
+    BufferedStream(Stream& source, std::size_t capacity, std::size_t chunk);
+    ~BufferedStream();
+
+    void start();
+
+    /**
+     * Sets the drop policy. Must be called before start().
+     */
+    void policy(DropPolicy policy);
+    DropPolicy policy() const;
+
+    /**
+     * Returns a snapshot of the overrun accounting.
+     */
+    OverrunStats stats() const;
+
+    /**
+     * Returns the number of frames currently buffered.
+     */
+    std::size_t buffered() const;
+
+    std::size_t capacity() const;
+
+    std::size_t lanes() const override;
+    void read(OutSample* const* out, std::size_t count) override;
+    void skip(std::size_t count) override;
+    Clock::time_point arrival() const override;
+
+    /**
+     * Returns true once the source has ended and the ring has been read
+     * empty.
+     */
+    bool eof() const override;
+
+    /**
+     * Returns true under DropPolicy::Decimate while the backlog is above
+     * half the capacity.
+     */
+    bool behind() const override;
+};
+
+#endif /* WFALL_BUFFERED_H */
@@ -0,0 +1,64 @@
+#ifndef WFALL_CACHE_H
+#define WFALL_CACHE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <cstddef>
+
+/**
+ * A thread-safe cache of immutable values that are expensive to make,
+ * such as window tables and filter kernels, keyed by what they are made
+ * from.
+ *
+ * The values are shared with their users. Each has a size, as given by
+ * the size function, and once the sizes add up to more than max_size,
+ * the values that no user holds any more are dropped. Values that are
+ * still held stay, so that the next user gets the same one.
+ */
+template <typename Key, typename T>
+class SharedCache {
+    std::mutex _mutex;
+    std::map<Key, std::shared_ptr<const T>> _values;
+    std::function<std::size_t(const T&)> _size_of;
+    std::size_t _max_size;
+    std::size_t _size = 0;
+
+public:
+    SharedCache(std::size_t max_size, std::function<std::size_t(const T&)> size_of)
+        : _size_of(std::move(size_of)), _max_size(max_size) {}
+
+    /**
+     * Returns the value of key, calling make() to make it if it is not
+     * in the cache. make() is called under the lock of the cache, so the
+     * same value is never made twice at once.
+     */
+    template <typename Make>
+    std::shared_ptr<const T> get(const Key& key, Make make)
+    {
+        std::lock_guard lock(_mutex);
+
+        auto it = _values.find(key);
+        if (it != _values.end()) {
+            return it->second;
+        }
+
+        std::shared_ptr<const T> value = make();
+
+        _size += _size_of(*value);
+        for (auto unused = _values.begin(); _size > _max_size && unused != _values.end(); ) {
+            if (unused->second.use_count() == 1) {
+                _size -= _size_of(*unused->second);
+                unused = _values.erase(unused);
+            } else {
+                ++unused;
+            }
+        }
+
+        _values.emplace(key, value);
+        return value;
+    }
+};
+
+#endif /* WFALL_CACHE_H */
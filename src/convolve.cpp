@@ -0,0 +1,198 @@
+#include "convolve.h"
+#include "cache.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+std::shared_ptr<const FilterSpectra> filter_spectra(const std::vector<float>& taps, std::size_t block)
+{
+    // Measured in spectrum points.
+    static SharedCache<std::pair<std::size_t, std::vector<float>>, FilterSpectra> cache(std::size_t(1) << 24,
+            [](const FilterSpectra& spectra) { return spectra.partitions.size() * 2 * spectra.block; });
+
+    return cache.get({block, taps}, [&] {
+        FftPlan plan(2 * block);
+        auto spectra = std::make_shared<FilterSpectra>();
+        spectra->block = block;
+
+        for (std::size_t start = 0; start < taps.size(); start += block) {
+            std::vector<std::complex<float>> part(2 * block);
+            std::size_t n = std::min(block, taps.size() - start);
+            std::copy_n(taps.begin() + start, n, part.begin());
+            plan.forward(part.data(), part.data());
+            spectra->partitions.push_back(std::move(part));
+        }
+
+        return std::shared_ptr<const FilterSpectra>(std::move(spectra));
+    });
+}
+
+FftConvolver::FftConvolver(const std::vector<float>& taps, std::size_t block)
+    : _plan(2 * block), _spectra(filter_spectra(taps, block))
+{
+    if (taps.empty()) {
+        throw std::invalid_argument("A filter needs at least one tap");
+    }
+
+    reset();
+}
+
+std::size_t FftConvolver::block() const
+{
+    return _spectra->block;
+}
+
+void FftConvolver::reset()
+{
+    const std::size_t n = 2 * block();
+    _delay_line.assign(_spectra->partitions.size(), std::vector<std::complex<float>>(n));
+    _window.assign(n, 0.0f);
+    _accum.assign(n, 0.0f);
+    _newest = 0;
+}
+
+void FftConvolver::process(const std::complex<float>* in, std::complex<float>* out)
+{
+    const std::size_t b = block();
+    const std::size_t n = 2 * b;
+    const std::size_t parts = _delay_line.size();
+
+    // Slide the input window by one block and transform it into the
+    // newest slot of the delay line.
+    std::copy(_window.begin() + b, _window.end(), _window.begin());
+    std::copy_n(in, b, _window.begin() + b);
+
+    _newest = (_newest + parts - 1) % parts;
+    _plan.forward(_window.data(), _delay_line[_newest].data());
+
+    // Multiply-accumulate in real arithmetic so that it vectorizes.
+    auto acc = reinterpret_cast<float*>(_accum.data());
+    std::fill(acc, acc + 2 * n, 0.0f);
+    for (std::size_t p = 0; p < parts; p++) {
+        auto x = reinterpret_cast<const float*>(_delay_line[(_newest + p) % parts].data());
+        auto h = reinterpret_cast<const float*>(_spectra->partitions[p].data());
+        for (std::size_t k = 0; k < n; k++) {
+            acc[2 * k] += x[2 * k] * h[2 * k] - x[2 * k + 1] * h[2 * k + 1];
+            acc[2 * k + 1] += x[2 * k] * h[2 * k + 1] + x[2 * k + 1] * h[2 * k];
+        }
+    }
+
+    _plan.inverse(_accum.data(), _accum.data());
+
+    // The first half is circular wrap-around, the second half is the
+    // linear convolution.
+    const float norm = 1.0f / n;
+    for (std::size_t i = 0; i < b; i++) {
+        out[i] = _accum[b + i] * norm;
+    }
+}
+
+std::vector<std::complex<float>> fft_convolve(const std::vector<std::complex<float>>& signal,
+        const std::vector<float>& taps, std::size_t block)
+{
+    FftConvolver conv(taps, block);
+
+    std::size_t total = signal.size() + taps.size() - 1;
+    std::vector<std::complex<float>> out((total + block - 1) / block * block);
+    std::vector<std::complex<float>> in(block);
+
+    for (std::size_t start = 0; start < total; start += block) {
+        std::fill(in.begin(), in.end(), 0.0f);
+        if (start < signal.size()) {
+            std::copy_n(signal.begin() + start, std::min(block, signal.size() - start), in.begin());
+        }
+        conv.process(in.data(), out.data() + start);
+    }
+
+    out.resize(total);
+
+    return out;
+}
+
+std::vector<float> read_taps(const std::string& path)
+{
+    std::ifstream f(path);
+    if (!f) {
+        throw std::runtime_error("Could not open " + path + " for reading.");
+    }
+
+    std::vector<float> taps;
+    std::string token;
+    while (f >> token) {
+        std::replace(token.begin(), token.end(), ',', ' ');
+        std::istringstream ss(token);
+        float tap;
+        while (ss >> tap) {
+            taps.push_back(tap);
+        }
+    }
+
+    if (taps.empty()) {
+        throw std::runtime_error("No filter taps in " + path);
+    }
+
+    return taps;
+}
+
+ConvolveStream::ConvolveStream(Stream& source, const std::vector<float>& taps, std::size_t block)
+    : _source(source), _conv(taps, block), _block(block)
+{
+    if (source.lanes() != 1) {
+        throw std::invalid_argument("ConvolveStream needs a single lane source");
+    }
+}
+
+void ConvolveStream::next_block()
+{
+    OutSample* ptr = _block.data();
+    _source.read(&ptr, _block.size());
+    _conv.process(_block.data(), _block.data());
+    _pending = _block.size();
+}
+
+void ConvolveStream::read(OutSample* const* out, std::size_t count)
+{
+    std::size_t done = 0;
+    while (done < count) {
+        if (_pending == 0) {
+            next_block();
+        }
+
+        std::size_t n = std::min(count - done, _pending);
+        std::copy_n(_block.end() - _pending, n, out[0] + done);
+        _pending -= n;
+        done += n;
+    }
+}
+
+void ConvolveStream::skip(std::size_t count)
+{
+    // The filter needs its whole history, so skipped blocks are still
+    // filtered.
+    while (count > 0) {
+        if (_pending == 0) {
+            next_block();
+        }
+
+        std::size_t n = std::min(count, _pending);
+        _pending -= n;
+        count -= n;
+    }
+}
+
+Stream::Clock::time_point ConvolveStream::arrival() const
+{
+    return _source.arrival();
+}
+
+bool ConvolveStream::eof() const
+{
+    return _source.eof();
+}
+
+bool ConvolveStream::behind() const
+{
+    return _source.behind();
+}
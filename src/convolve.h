@@ -0,0 +1,104 @@
+#ifndef WFALL_CONVOLVE_H
+#define WFALL_CONVOLVE_H
+
+#include <vector>
+#include <complex>
+#include <memory>
+#include <string>
+
+#include "fft.h"
+#include "fftseq.h"
+
+/**
+ * The spectra of the partitions of a filter, as used by FftConvolver.
+ */
+struct FilterSpectra {
+    std::size_t block;
+    std::vector<std::vector<std::complex<float>>> partitions;
+};
+
+/**
+ * Returns the partition spectra of a filter for the given block size.
+ *
+ * The spectra are cached, so filters that are used by several
+ * convolvers or recreated with the same taps are only transformed once.
+ * The returned spectra are immutable and shared between threads.
+ */
+std::shared_ptr<const FilterSpectra> filter_spectra(const std::vector<float>& taps, std::size_t block);
+
+/**
+ * Uniformly partitioned overlap-save FFT convolution.
+ *
+ * The filter is split into partitions of block() taps. Each block of
+ * input is transformed once and kept in a frequency domain delay line,
+ * and the output block is the inverse transform of the sum of the
+ * delayed input spectra times the partition spectra. The latency is one
+ * block no matter how long the filter is, and the cost per sample grows
+ * with the number of partitions instead of the number of taps.
+ */
+class FftConvolver {
+    FftPlan _plan;
+    std::shared_ptr<const FilterSpectra> _spectra;
+    std::vector<std::vector<std::complex<float>>> _delay_line;
+    std::size_t _newest = 0;
+    std::vector<std::complex<float>> _window;
+    std::vector<std::complex<float>> _accum;
+
+public:
+    /**
+     * ctor.
+     *
+     * block must be a power of two.
+     */
+    FftConvolver(const std::vector<float>& taps, std::size_t block);
+
+    std::size_t block() const;
+
+    /**
+     * Filters block() samples from in and writes them to out.
+     *
+     * in and out may be the same array.
+     */
+    void process(const std::complex<float>* in, std::complex<float>* out);
+
+    /**
+     * Clears the filter history.
+     */
+    void reset();
+};
+
+/**
+ * Convolves a whole signal with a filter.
+ *
+ * Returns signal.size() + taps.size() - 1 samples.
+ */
+std::vector<std::complex<float>> fft_convolve(const std::vector<std::complex<float>>& signal,
+        const std::vector<float>& taps, std::size_t block = 1024);
+
+/**
+ * Reads filter taps from a text file, separated by whitespace or commas.
+ */
+std::vector<float> read_taps(const std::string& path);
+
+/**
+ * Filters a Stream with a long FIR filter using an FftConvolver.
+ */
+class ConvolveStream : public Stream {
+    Stream& _source;
+    FftConvolver _conv;
+    std::vector<OutSample> _block;
+    std::size_t _pending = 0;
+
+    void next_block();
+
+public:
+    ConvolveStream(Stream& source, const std::vector<float>& taps, std::size_t block = 1024);
+
+    void read(OutSample* const* out, std::size_t count) override;
+    void skip(std::size_t count) override;
+    Clock::time_point arrival() const override;
+    bool eof() const override;
+    bool behind() const override;
+};
+
+#endif /* WFALL_CONVOLVE_H */
@@ -0,0 +1,146 @@
+#include "cqt.h"
+#include "fft.h"
+#include "cache.h"
+
+#include <cmath>
+#include <numbers>
+#include <tuple>
+#include <bit>
+#include <algorithm>
+#include <stdexcept>
+
+/**
+ * Kernel values below this fraction of the peak of their row are
+ * dropped, which keeps the leakage of a bin below -60 dB.
+ */
+static constexpr float KERNEL_THRESHOLD = 1e-3f;
+
+double cqt_q(std::size_t bins_per_octave)
+{
+    return 1.0 / (std::exp2(1.0 / bins_per_octave) - 1.0);
+}
+
+/**
+ * Returns the center frequency of bin k.
+ */
+static double bin_freq(const CqtSpec& spec, std::size_t k)
+{
+    return spec.min_freq * std::exp2(double(k) / spec.bins_per_octave);
+}
+
+/**
+ * Returns the length of the kernel of bin k.
+ */
+static std::size_t kernel_length(const CqtSpec& spec, std::size_t k)
+{
+    return std::ceil(cqt_q(spec.bins_per_octave) / bin_freq(spec, k));
+}
+
+std::size_t cqt_fft_size(const CqtSpec& spec)
+{
+    return std::bit_ceil(kernel_length(spec, 0));
+}
+
+/**
+ * Returns the first bin whose kernel fits in fft_size and the number of
+ * bins from it up to half the sample rate.
+ */
+static std::pair<std::size_t, std::size_t> bin_range(const CqtSpec& spec, std::size_t fft_size)
+{
+    if (spec.min_freq <= 0.0f || spec.min_freq >= 0.5f || spec.bins_per_octave == 0) {
+        throw std::invalid_argument("Invalid constant-Q transform parameters");
+    }
+
+    std::size_t first = 0;
+    while (bin_freq(spec, first) < 0.5 && kernel_length(spec, first) > fft_size) {
+        first++;
+    }
+
+    std::size_t end = first;
+    while (bin_freq(spec, end) < 0.5) {
+        end++;
+    }
+
+    return {first, end - first};
+}
+
+std::size_t cqt_bins(const CqtSpec& spec, std::size_t fft_size)
+{
+    return bin_range(spec, fft_size).second;
+}
+
+CqtKernel::CqtKernel(const CqtSpec& spec, std::size_t fft_size, const WindowSpec& window)
+    : kernel(fft_size)
+{
+    using namespace std::numbers;
+
+    auto [first, bins] = bin_range(spec, fft_size);
+    FftPlan plan(fft_size);
+    std::vector<std::complex<float>> temporal(fft_size);
+    std::vector<std::complex<float>> spectral(fft_size);
+
+    for (std::size_t k = first; k < first + bins; k++) {
+        const double freq = bin_freq(spec, k);
+        const std::size_t length = kernel_length(spec, k);
+        const std::vector<float> win = make_window(window, length);
+
+        // Normalized so that a sinusoid at freq gives its amplitude.
+        double sum = 0.0;
+        double power = 0.0;
+        for (float w : win) {
+            sum += w;
+            power += double(w) * w;
+        }
+
+        std::fill(temporal.begin(), temporal.end(), 0.0f);
+        const std::size_t offset = (fft_size - length) / 2;
+        for (std::size_t n = 0; n < length; n++) {
+            temporal[offset + n] = std::polar(win[n] / sum, 2.0 * pi * freq * n);
+        }
+        plan.forward(temporal.data(), spectral.data());
+
+        float peak = 0.0f;
+        for (const auto& x : spectral) {
+            peak = std::max(peak, std::abs(x));
+        }
+
+        // The correlation with the kernel is the sum of the FFT of the
+        // frame times the conjugated FFT of the kernel, over fft_size.
+        for (std::size_t j = 0; j < fft_size; j++) {
+            if (std::abs(spectral[j]) >= KERNEL_THRESHOLD * peak) {
+                kernel.push(j, std::conj(spectral[j]) / float(fft_size));
+            }
+        }
+        kernel.end_row();
+
+        freqs.push_back(freq);
+        noise_gain.push_back(power / (sum * sum));
+    }
+}
+
+std::size_t CqtKernel::bins() const
+{
+    return kernel.rows();
+}
+
+void CqtKernel::power(const std::complex<float>* fft, const float* norm, float* out) const
+{
+    for (std::size_t k = 0; k < kernel.rows(); k++) {
+        out[k] = norm[k] * std::norm(kernel.dot(k, fft));
+    }
+}
+
+std::shared_ptr<const CqtKernel> cqt_kernel(const CqtSpec& spec, std::size_t fft_size,
+        const WindowSpec& window)
+{
+    using Key = std::tuple<float, std::size_t, std::size_t, WindowType, float>;
+
+    // Measured in nonzero kernel entries.
+    static SharedCache<Key, CqtKernel> cache(std::size_t(1) << 24,
+            [](const CqtKernel& kernel) { return kernel.kernel.nonzeros(); });
+
+    Key key{spec.min_freq, spec.bins_per_octave, fft_size, window.type, window.param};
+    return cache.get(key, [&] {
+        return std::make_shared<const CqtKernel>(spec, fft_size, window);
+    });
+}
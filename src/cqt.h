@@ -0,0 +1,85 @@
+#ifndef WFALL_CQT_H
+#define WFALL_CQT_H
+
+#include <vector>
+#include <complex>
+#include <memory>
+
+#include "sparse.h"
+#include "window.h"
+
+/**
+ * Parameters of a constant-Q transform.
+ *
+ * Frequencies are in cycles per sample, so that a kernel does not depend
+ * on the sample rate.
+ */
+struct CqtSpec {
+    /** Center frequency of the lowest bin, 0 disables the transform. */
+    float min_freq = 0.0f;
+    std::size_t bins_per_octave = 24;
+
+    bool operator==(const CqtSpec&) const = default;
+};
+
+/**
+ * Returns the quality factor, center frequency over bandwidth, of a
+ * transform with the given resolution.
+ */
+double cqt_q(std::size_t bins_per_octave);
+
+/**
+ * Returns the FFT size that holds the longest kernel of spec.
+ */
+std::size_t cqt_fft_size(const CqtSpec& spec);
+
+/**
+ * Returns the number of bins of spec that fit in an FFT of fft_size,
+ * from the lowest whose kernel fits up to half the sample rate.
+ */
+std::size_t cqt_bins(const CqtSpec& spec, std::size_t fft_size);
+
+/**
+ * The spectral kernel of a constant-Q transform, after Brown and
+ * Puckette, "An efficient algorithm for the calculation of a constant Q
+ * transform" (1992).
+ *
+ * Bin k correlates the frame with a windowed complex exponential of
+ * Q / f_k samples, centered in the frame. By Parseval's theorem that is
+ * a product of the FFT of the frame with the conjugated FFT of the
+ * exponential, which is concentrated around f_k. The small values are
+ * dropped, leaving a sparse matrix with a few entries per bin, so the
+ * whole transform costs one FFT and a sparse matrix-vector product.
+ */
+struct CqtKernel {
+    /** One row per bin, applied to the unnormalized FFT of a frame. */
+    CsrMatrix<std::complex<float>> kernel;
+    /** Center frequency of every bin, in cycles per sample. */
+    std::vector<float> freqs;
+    /**
+     * Sum of the squared kernel weights in time of every bin, the power
+     * it passes of white noise of unit power.
+     */
+    std::vector<float> noise_gain;
+
+    CqtKernel(const CqtSpec& spec, std::size_t fft_size, const WindowSpec& window);
+
+    std::size_t bins() const;
+
+    /**
+     * Computes the power of every bin from the FFT of a frame, scaled by
+     * the per bin norm.
+     */
+    void power(const std::complex<float>* fft, const float* norm, float* out) const;
+};
+
+/**
+ * Returns the kernel for the given parameters.
+ *
+ * Kernels are computed once per configuration and then shared read-only,
+ * like the tables of window_table. Safe to call from any thread.
+ */
+std::shared_ptr<const CqtKernel> cqt_kernel(const CqtSpec& spec, std::size_t fft_size,
+        const WindowSpec& window);
+
+#endif /* WFALL_CQT_H */
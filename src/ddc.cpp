@@ -0,0 +1,74 @@
+#include "ddc.h"
+
+#include <numbers>
+#include <stdexcept>
+#include <cmath>
+
+DdcStream::DdcStream(Stream& source, float rate, float center, std::size_t decimation,
+        std::size_t taps_per_phase)
+    : _source(source),
+      _freq(-2.0 * std::numbers::pi * center / rate),
+      // The cutoff sits inside the output band so that the transition
+      // band, and not the passband, is what folds over at the band edges.
+      _fir(design_lowpass(decimation * taps_per_phase, 0.4f / decimation), decimation)
+{
+    if (source.lanes() != 1) {
+        throw std::invalid_argument("DdcStream needs a single lane source");
+    }
+}
+
+std::size_t DdcStream::decimation() const
+{
+    return _fir.decimation();
+}
+
+void DdcStream::read(OutSample* const* out, std::size_t count)
+{
+    std::size_t n = count * _fir.decimation();
+    _in.resize(n);
+
+    OutSample* ptr = _in.data();
+    _source.read(&ptr, n);
+
+    _phase = mix(_in.data(), _in.data(), n, _phase, _freq);
+    _fir.process(_in.data(), n, out[0]);
+}
+
+void DdcStream::skip(std::size_t count)
+{
+    const std::size_t decimation = _fir.decimation();
+    std::size_t n = count * decimation;
+
+    // Skip what the filter will never see, then run the last part
+    // through it so that the next output is computed from real input.
+    // A whole number of outputs is fed to keep the decimation phase.
+    std::size_t feed = (_fir.taps() + decimation - 2) / decimation * decimation;
+    if (n > feed) {
+        _source.skip(n - feed);
+        _phase = std::remainder(_phase + _freq * (n - feed), 2.0 * std::numbers::pi);
+        n = feed;
+    }
+
+    _in.resize(n);
+    OutSample* ptr = _in.data();
+    _source.read(&ptr, n);
+    _phase = mix(_in.data(), _in.data(), n, _phase, _freq);
+
+    _discard.resize(n / decimation);
+    _fir.process(_in.data(), n, _discard.data());
+}
+
+Stream::Clock::time_point DdcStream::arrival() const
+{
+    return _source.arrival();
+}
+
+bool DdcStream::eof() const
+{
+    return _source.eof();
+}
+
+bool DdcStream::behind() const
+{
+    return _source.behind();
+}
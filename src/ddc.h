@@ -0,0 +1,46 @@
+#ifndef WFALL_DDC_H
+#define WFALL_DDC_H
+
+#include "fftseq.h"
+#include "dsp.h"
+
+/**
+ * A digital down-converter.
+ *
+ * Wraps a Stream, shifts the chosen center frequency to zero with a
+ * numerically controlled oscillator and decimates the result with a
+ * lowpass FIR filter. The output is a complex signal at
+ * rate / decimation that covers the band around the center frequency,
+ * so the FFTs downstream can be much smaller for the same resolution.
+ * The filter passes the inner 80% of that band; the outer edges roll
+ * off, but nothing from outside the band folds into the inner part.
+ */
+class DdcStream : public Stream {
+    Stream& _source;
+    double _phase = 0.0;
+    double _freq;
+    FirDecimator _fir;
+    std::vector<OutSample> _in;
+    std::vector<OutSample> _discard;
+
+public:
+    /**
+     * ctor.
+     *
+     * rate is the sample rate of the source and center the frequency
+     * (in the same unit) that is moved to zero. The lowpass filter has
+     * taps_per_phase taps for every output phase.
+     */
+    DdcStream(Stream& source, float rate, float center, std::size_t decimation,
+            std::size_t taps_per_phase = 16);
+
+    std::size_t decimation() const;
+
+    void read(OutSample* const* out, std::size_t count) override;
+    void skip(std::size_t count) override;
+    Clock::time_point arrival() const override;
+    bool eof() const override;
+    bool behind() const override;
+};
+
+#endif /* WFALL_DDC_H */
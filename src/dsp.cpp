@@ -0,0 +1,228 @@
+#include "dsp.h"
+
+#include <cmath>
+#include <numbers>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+
+std::vector<float> design_lowpass(std::size_t taps, float cutoff)
+{
+    using namespace std::numbers;
+
+    if (taps == 0) {
+        throw std::invalid_argument("A filter needs at least one tap");
+    }
+
+    std::vector<float> h(taps);
+    const double center = 0.5 * (taps - 1);
+    for (std::size_t n = 0; n < taps; n++) {
+        double x = n - center;
+        double sinc = (x == 0.0) ? 2.0 * cutoff : std::sin(2.0 * pi * cutoff * x) / (pi * x);
+        double w = (taps == 1) ? 1.0 : 0.42
+            - 0.50 * std::cos(2.0 * pi * n / (taps - 1))
+            + 0.08 * std::cos(4.0 * pi * n / (taps - 1));
+        h[n] = sinc * w;
+    }
+
+    float sum = std::accumulate(h.begin(), h.end(), 0.0f);
+    for (float& x : h) {
+        x /= sum;
+    }
+
+    return h;
+}
+
+std::vector<float> design_halfband(std::size_t taps)
+{
+    using namespace std::numbers;
+
+    if (taps < 3 || taps % 4 != 3) {
+        throw std::invalid_argument("A half-band filter needs 4m + 3 taps");
+    }
+
+    std::vector<float> h(taps, 0.0f);
+    const std::ptrdiff_t center = (taps - 1) / 2;
+    double sum = 0.0;
+    for (std::size_t n = 0; n < taps; n++) {
+        std::ptrdiff_t x = std::ptrdiff_t(n) - center;
+        if (x == 0 || x % 2 == 0) {
+            continue;
+        }
+        double w = 0.42
+            - 0.50 * std::cos(2.0 * pi * n / (taps - 1))
+            + 0.08 * std::cos(4.0 * pi * n / (taps - 1));
+        h[n] = std::sin(0.5 * pi * x) / (pi * x) * w;
+        sum += h[n];
+    }
+
+    // Normalize the odd taps to sum to 0.5 so that the DC gain is
+    // exactly one, without disturbing the zeros.
+    for (std::size_t n = 0; n < taps; n++) {
+        h[n] *= 0.5 / sum;
+    }
+    h[center] = 0.5f;
+
+    return h;
+}
+
+float dot(const float* a, const float* b, std::size_t n)
+{
+    float acc[8] = {};
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        for (std::size_t j = 0; j < 8; j++) {
+            acc[j] += a[i + j] * b[i + j];
+        }
+    }
+
+    float sum = 0.0f;
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+
+    return sum + ((acc[0] + acc[4]) + (acc[1] + acc[5])) + ((acc[2] + acc[6]) + (acc[3] + acc[7]));
+}
+
+double mix(const std::complex<float>* in, std::complex<float>* out,
+        std::size_t n, double phase, double freq)
+{
+    // Eight oscillators offset by one sample each, all advanced by
+    // eight samples per step. They are restarted from the exact phase
+    // on every call so that rounding errors do not accumulate.
+    float osc_re[8], osc_im[8];
+    for (std::size_t j = 0; j < 8; j++) {
+        osc_re[j] = std::cos(phase + freq * j);
+        osc_im[j] = std::sin(phase + freq * j);
+    }
+    const float step_re = std::cos(8.0 * freq);
+    const float step_im = std::sin(8.0 * freq);
+
+    auto in_f = reinterpret_cast<const float*>(in);
+    auto out_f = reinterpret_cast<float*>(out);
+
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        for (std::size_t j = 0; j < 8; j++) {
+            float re = in_f[2 * (i + j)];
+            float im = in_f[2 * (i + j) + 1];
+            out_f[2 * (i + j)] = re * osc_re[j] - im * osc_im[j];
+            out_f[2 * (i + j) + 1] = re * osc_im[j] + im * osc_re[j];
+
+            float next_re = osc_re[j] * step_re - osc_im[j] * step_im;
+            osc_im[j] = osc_re[j] * step_im + osc_im[j] * step_re;
+            osc_re[j] = next_re;
+        }
+    }
+
+    for (std::size_t j = 0; i < n; i++, j++) {
+        float re = in_f[2 * i];
+        float im = in_f[2 * i + 1];
+        out_f[2 * i] = re * osc_re[j] - im * osc_im[j];
+        out_f[2 * i + 1] = re * osc_im[j] + im * osc_re[j];
+    }
+
+    return std::remainder(phase + freq * n, 2.0 * std::numbers::pi);
+}
+
+FirDecimator::FirDecimator(const std::vector<float>& taps, std::size_t decimation)
+    : _taps(taps.rbegin(), taps.rend()), _decimation(decimation)
+{
+    if (taps.empty() || decimation == 0) {
+        throw std::invalid_argument("FirDecimator needs taps and a non-zero decimation");
+    }
+
+    reset();
+}
+
+void FirDecimator::reset()
+{
+    _fill = _taps.size() - 1;
+    _skip = 0;
+    _re.assign(_fill, 0.0f);
+    _im.assign(_fill, 0.0f);
+}
+
+std::size_t FirDecimator::process(const std::complex<float>* in, std::size_t n, std::complex<float>* out)
+{
+    const std::size_t len = _taps.size();
+    _re.resize(_fill + n);
+    _im.resize(_fill + n);
+    for (std::size_t i = 0; i < n; i++) {
+        _re[_fill + i] = in[i].real();
+        _im[_fill + i] = in[i].imag();
+    }
+    _fill += n;
+
+    // The taps are stored reversed, so each output is a plain dot
+    // product with a window of the input.
+    std::size_t count = 0;
+    std::size_t pos = _skip;
+    for (; pos + len <= _fill; pos += _decimation) {
+        out[count++] = std::complex<float>(
+                dot(_taps.data(), _re.data() + pos, len),
+                dot(_taps.data(), _im.data() + pos, len));
+    }
+
+    // Keep the samples that later outputs still need. If the decimation
+    // is longer than the filter, the next output may start beyond the
+    // samples we have.
+    std::size_t keep_from = std::min(pos, _fill);
+    std::copy(_re.begin() + keep_from, _re.begin() + _fill, _re.begin());
+    std::copy(_im.begin() + keep_from, _im.begin() + _fill, _im.begin());
+    _fill -= keep_from;
+    _skip = pos - keep_from;
+
+    return count;
+}
+
+HalfbandDecimator::HalfbandDecimator(std::size_t taps)
+{
+    std::vector<float> h = design_halfband(taps);
+
+    // The non-zero taps around the center, reversed so that each output
+    // is a dot product with a window of the even samples.
+    for (std::size_t n = 0; n < taps; n += 2) {
+        _coef.push_back(h[taps - 1 - n]);
+    }
+    _center = (taps - 3) / 4;
+
+    reset();
+}
+
+void HalfbandDecimator::reset()
+{
+    _fill = _coef.size() - 1;
+    _even_re.assign(_fill, 0.0f);
+    _even_im.assign(_fill, 0.0f);
+    _odd_re.assign(_fill, 0.0f);
+    _odd_im.assign(_fill, 0.0f);
+}
+
+void HalfbandDecimator::process(const std::complex<float>* in, std::size_t n, std::complex<float>* out)
+{
+    const std::size_t count = n / 2;
+    const std::size_t len = _coef.size();
+
+    _even_re.resize(_fill + count);
+    _even_im.resize(_fill + count);
+    _odd_re.resize(_fill + count);
+    _odd_im.resize(_fill + count);
+    for (std::size_t i = 0; i < count; i++) {
+        _even_re[_fill + i] = in[2 * i].real();
+        _even_im[_fill + i] = in[2 * i].imag();
+        _odd_re[_fill + i] = in[2 * i + 1].real();
+        _odd_im[_fill + i] = in[2 * i + 1].imag();
+    }
+
+    for (std::size_t k = 0; k < count; k++) {
+        out[k] = std::complex<float>(
+                dot(_coef.data(), _even_re.data() + k, len) + 0.5f * _odd_re[k + _center],
+                dot(_coef.data(), _even_im.data() + k, len) + 0.5f * _odd_im[k + _center]);
+    }
+
+    for (auto* v : {&_even_re, &_even_im, &_odd_re, &_odd_im}) {
+        std::copy(v->begin() + count, v->end(), v->begin());
+        v->resize(_fill);
+    }
+}
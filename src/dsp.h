@@ -0,0 +1,128 @@
+#ifndef WFALL_DSP_H
+#define WFALL_DSP_H
+
+#include <vector>
+#include <complex>
+
+/**
+ * Designs a windowed-sinc lowpass FIR filter.
+ *
+ * cutoff is the -6 dB frequency as a fraction of the sample rate, in
+ * (0, 0.5). The filter is windowed with a Blackman window and
+ * normalized to unity gain at DC.
+ */
+std::vector<float> design_lowpass(std::size_t taps, float cutoff);
+
+/**
+ * Designs a half-band lowpass FIR filter.
+ *
+ * taps must be of the form 4m + 3. Every other tap of a half-band
+ * filter is zero except for the center tap, which is 0.5. The cutoff is
+ * at a quarter of the sample rate.
+ */
+std::vector<float> design_halfband(std::size_t taps);
+
+/**
+ * Dot product of two float arrays.
+ *
+ * Uses several partial sums so that the compiler can vectorize the
+ * reduction without reassociating floating point math.
+ */
+float dot(const float* a, const float* b, std::size_t n);
+
+/**
+ * Sets out to in rotated by an oscillator.
+ *
+ * Computes out[i] = in[i] * osc[i] where osc is a numerically
+ * controlled oscillator of the given frequency (radians per sample)
+ * starting at phase. Returns the phase after the last sample.
+ */
+double mix(const std::complex<float>* in, std::complex<float>* out,
+        std::size_t n, double phase, double freq);
+
+/**
+ * A decimating FIR filter for complex signals.
+ *
+ * Only every decimation'th output is computed, which is equivalent to a
+ * polyphase decimator. The signal is kept as separate real and
+ * imaginary arrays so that the dot products vectorize.
+ */
+class FirDecimator {
+    std::vector<float> _taps;
+    std::size_t _decimation;
+    std::vector<float> _re;
+    std::vector<float> _im;
+    std::size_t _fill;
+    std::size_t _skip;
+
+public:
+    /**
+     * ctor.
+     *
+     * Constructs a decimator from the filter taps and the decimation
+     * factor.
+     */
+    FirDecimator(const std::vector<float>& taps, std::size_t decimation);
+
+    std::size_t decimation() const { return _decimation; }
+
+    std::size_t taps() const { return _taps.size(); }
+
+    /**
+     * Filters n input samples and writes the outputs to out.
+     *
+     * Returns the number of outputs written, which is n / decimation
+     * when n is a multiple of the decimation.
+     */
+    std::size_t process(const std::complex<float>* in, std::size_t n, std::complex<float>* out);
+
+    /**
+     * Clears the filter history.
+     */
+    void reset();
+};
+
+/**
+ * A half-band decimate-by-two filter for complex signals.
+ *
+ * The input is split into its even and odd samples. All non-zero taps
+ * apart from the center one fall on the even samples, so each output is
+ * a dense dot product of (taps + 1) / 2 coefficients with the even
+ * samples plus half of one odd sample. The zero taps cost nothing.
+ */
+class HalfbandDecimator {
+    std::vector<float> _coef;
+    std::size_t _center;
+    std::vector<float> _even_re;
+    std::vector<float> _even_im;
+    std::vector<float> _odd_re;
+    std::vector<float> _odd_im;
+    std::size_t _fill;
+
+public:
+    /**
+     * ctor.
+     *
+     * Constructs a decimator from a filter made by design_halfband.
+     */
+    explicit HalfbandDecimator(std::size_t taps);
+
+    /**
+     * Returns the number of taps of the full filter.
+     */
+    std::size_t taps() const { return 2 * _coef.size() - 1; }
+
+    /**
+     * Filters n input samples and writes n / 2 outputs to out.
+     *
+     * n must be even. out may be the same array as in.
+     */
+    void process(const std::complex<float>* in, std::size_t n, std::complex<float>* out);
+
+    /**
+     * Clears the filter history.
+     */
+    void reset();
+};
+
+#endif /* WFALL_DSP_H */
@@ -0,0 +1,209 @@
+#include "feed.h"
+
+#include <algorithm>
+#include <limits>
+
+SampleFeed::SampleFeed(Stream& stream) : _stream(stream) {}
+
+SampleFeed::~SampleFeed()
+{
+    close();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+std::size_t SampleFeed::lanes() const
+{
+    return _stream.lanes();
+}
+
+bool SampleFeed::behind() const
+{
+    return _stream.behind();
+}
+
+void SampleFeed::start()
+{
+    _thread = std::thread(&SampleFeed::feed_fn, this);
+}
+
+void SampleFeed::close()
+{
+    std::lock_guard lock(_mutex);
+    _closed = true;
+    _cond.notify_all();
+}
+
+std::pair<SampleFeed::Tap, int64_t> SampleFeed::attach(std::size_t frame, std::size_t span)
+{
+    std::lock_guard lock(_mutex);
+
+    Reader reader;
+    reader.keep = _written - int64_t(frame);
+    reader.frame = frame;
+    reader.span = span;
+    _readers.push_back(reader);
+    _cond.notify_all();
+
+    return {_readers.size() - 1, _written};
+}
+
+void SampleFeed::detach(Tap tap)
+{
+    std::lock_guard lock(_mutex);
+    _readers[tap].active = false;
+    _cond.notify_all();
+}
+
+void SampleFeed::reserve(Tap tap, std::size_t frame, std::size_t span)
+{
+    std::lock_guard lock(_mutex);
+    _readers[tap].frame = frame;
+    _readers[tap].span = span;
+    _cond.notify_all();
+}
+
+bool SampleFeed::ready(const Reader& reader) const
+{
+    return _history && _written >= reader.end && _history->max_frame() >= reader.frame;
+}
+
+std::shared_ptr<const SampleHistory> SampleFeed::wait(Tap tap, int64_t start, int64_t end, int64_t keep)
+{
+    std::unique_lock lock(_mutex);
+
+    Reader& reader = _readers[tap];
+    reader.keep = keep;
+    reader.start = start;
+    reader.end = end;
+    reader.waiting = true;
+    _cond.notify_all();
+
+    _cond.wait(lock, [&] { return _closed || _ended || !reader.active || ready(reader); });
+    reader.waiting = false;
+
+    if (_closed || !reader.active || !ready(reader)) {
+        return nullptr;
+    }
+
+    return _history;
+}
+
+SampleFeed::Clock::time_point SampleFeed::arrival(int64_t pos)
+{
+    std::lock_guard lock(_mutex);
+
+    auto mark = std::upper_bound(_marks.begin(), _marks.end(), pos,
+            [](int64_t pos, const Mark& mark) { return pos < mark.end; });
+    if (mark != _marks.end()) {
+        return mark->time;
+    }
+
+    return _marks.empty() ? Clock::now() : _marks.back().time;
+}
+
+void SampleFeed::grow()
+{
+    std::size_t frame = 0;
+    std::size_t span = 0;
+    for (const Reader& reader : _readers) {
+        if (reader.active) {
+            frame = std::max(frame, reader.frame);
+            span = std::max(span, reader.span);
+        }
+    }
+
+    if (frame == 0 || (_history && _history->max_frame() >= frame && _history->capacity() >= span)) {
+        return;
+    }
+
+    // The history never shrinks, so the other readers keep their
+    // samples.
+    std::size_t capacity = std::max(span, frame);
+    if (_history) {
+        capacity = std::max(capacity, _history->capacity());
+        frame = std::max(frame, _history->max_frame());
+    }
+
+    auto history = std::make_shared<SampleHistory>(capacity, frame, _stream.lanes());
+    if (_history) {
+        // Samples that were already gone read as zeros, as at the start.
+        std::size_t count = std::min<int64_t>(_written, _history->capacity());
+        history->skip(_written - count);
+        history->append(*_history, count);
+    }
+    _history = history;
+    _cond.notify_all();
+}
+
+void SampleFeed::feed_fn()
+{
+    const std::size_t lanes = _stream.lanes();
+    std::vector<std::complex<float>*> ptrs(lanes);
+
+    std::unique_lock lock(_mutex);
+    while (!_closed && !_ended) {
+        grow();
+
+        // Read up to the nearest end of a frame that a reader waits for,
+        // reading the first sample of a frame on its own so that its
+        // arrival is known. If every reader waits for a frame that starts
+        // later, the samples before it are skipped.
+        int64_t keep = _written;
+        int64_t target = std::numeric_limits<int64_t>::max();
+        int64_t next_start = target;
+        bool all_waiting = true;
+        for (const Reader& reader : _readers) {
+            if (!reader.active) {
+                continue;
+            }
+            keep = std::min(keep, reader.keep);
+            if (!reader.waiting || reader.end <= _written) {
+                all_waiting = false;
+                continue;
+            }
+            next_start = std::min(next_start, reader.start);
+            target = std::min(target, _written <= reader.start ? reader.start + 1 : reader.end);
+        }
+
+        // Samples that a reader may still read are not overwritten.
+        const bool skip = all_waiting && next_start > _written;
+        int64_t to = skip ? next_start : target;
+        if (_history) {
+            to = std::min<int64_t>(to, keep + _history->capacity());
+        }
+
+        if (!_history || target == std::numeric_limits<int64_t>::max() || to <= _written) {
+            _cond.wait(lock);
+            continue;
+        }
+
+        std::shared_ptr<SampleHistory> history = _history;
+        std::size_t n = to - _written;
+        lock.unlock();
+
+        if (skip) {
+            _stream.skip(n);
+            history->skip(n);
+        } else {
+            n = std::min(n, history->write_contiguous());
+            for (std::size_t l = 0; l < lanes; l++) {
+                ptrs[l] = history->write_ptr(l);
+            }
+            _stream.read(ptrs.data(), n);
+            history->commit(n);
+        }
+        Clock::time_point time = _stream.arrival();
+        const bool ended = _stream.eof();
+
+        lock.lock();
+        _ended = ended;
+        _written += n;
+        _marks.push_back({_written, time});
+        while (_marks.size() > 1 && _marks.front().end <= keep) {
+            _marks.pop_front();
+        }
+        _cond.notify_all();
+    }
+}
@@ -0,0 +1,145 @@
+#ifndef WFALL_FEED_H
+#define WFALL_FEED_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+
+#include "fftseq.h"
+#include "history.h"
+
+/**
+ * Reads a stream into a SampleHistory on its own thread, for any number
+ * of readers to compute frames from in place.
+ *
+ * Every reader attaches with the longest frame it reads and the span of
+ * samples it may hold on to, and then asks for one frame at a time with
+ * wait(). The feed reads just far enough to complete the nearest frame
+ * that a reader waits for. It skips the input that no reader wants, and
+ * never overwrites a sample that a reader may still read, so a slow
+ * reader holds up the others rather than losing samples.
+ *
+ * Several FftSeqs with different sizes, windows and rates can share a
+ * feed, which decodes each sample once for all of them.
+ *
+ * Positions count samples since the start of the stream. The samples
+ * before position 0 read as zeros.
+ *
+ * When the stream ends, the feed stops reading. The frame that runs into
+ * the end is still served, padded with zeros, and the frames after it are
+ * not.
+ */
+class SampleFeed {
+public:
+    /** Identifies a reader of the feed. */
+    using Tap = std::size_t;
+
+private:
+    using Clock = Stream::Clock;
+
+    struct Reader {
+        bool active = true;
+        bool waiting = false;
+        /** Oldest position that the reader may still read. */
+        int64_t keep = 0;
+        /** The frame that the reader waits for. */
+        int64_t start = 0;
+        int64_t end = 0;
+        std::size_t frame = 0;
+        std::size_t span = 0;
+    };
+
+    /** The samples before end arrived at time, after the previous mark. */
+    struct Mark {
+        int64_t end;
+        Clock::time_point time;
+    };
+
+    Stream& _stream;
+    std::shared_ptr<SampleHistory> _history;
+    int64_t _written = 0;
+    std::deque<Mark> _marks;
+    std::deque<Reader> _readers;
+    bool _closed = false;
+    bool _ended = false;
+
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::thread _thread;
+
+    void feed_fn();
+
+    /**
+     * Replaces the history with a larger one if a reader needs it,
+     * keeping the samples that may still be read.
+     */
+    void grow();
+
+    bool ready(const Reader& reader) const;
+
+public:
+    SampleFeed(Stream& stream);
+    ~SampleFeed();
+
+    SampleFeed(const SampleFeed&) = delete;
+    SampleFeed& operator=(const SampleFeed&) = delete;
+
+    std::size_t lanes() const;
+
+    /**
+     * Returns true if the readers have fallen behind the stream, see
+     * Stream::behind.
+     */
+    bool behind() const;
+
+    /**
+     * Starts the thread that reads the stream. Readers can attach before
+     * or after.
+     */
+    void start();
+
+    /**
+     * Stops reading and wakes up all readers.
+     */
+    void close();
+
+    /**
+     * Adds a reader of frames of up to frame samples, which holds on to
+     * at most span samples, counted from the start of the oldest frame
+     * it still reads to the end of the newest. Returns the reader and
+     * the position of the newest sample read so far.
+     */
+    std::pair<Tap, int64_t> attach(std::size_t frame, std::size_t span);
+
+    /**
+     * Removes a reader, waking it up if it waits.
+     */
+    void detach(Tap tap);
+
+    /**
+     * Changes the frame and span of a reader, see attach.
+     */
+    void reserve(Tap tap, std::size_t frame, std::size_t span);
+
+    /**
+     * Blocks until the samples from start to end can be read, and tells
+     * the feed that the reader no longer reads the samples before keep.
+     *
+     * Returns the history to read them from, which stays valid as long
+     * as it is held, or nullptr if the feed or the reader was closed, or
+     * the stream ended before end.
+     */
+    std::shared_ptr<const SampleHistory> wait(Tap tap, int64_t start, int64_t end, int64_t keep);
+
+    /**
+     * Returns the arrival time of the sample at pos, which must not be
+     * older than the keep position of the reader.
+     */
+    Clock::time_point arrival(int64_t pos);
+};
+
+#endif /* WFALL_FEED_H */
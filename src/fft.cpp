@@ -1,5 +1,10 @@
 #include "fft.h"
 
+#include <bit>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+
 void ditfft2(CFftView in, FftView out)
 {
     using namespace std::complex_literals;
@@ -22,3 +27,84 @@ void ditfft2(CFftView in, FftView out)
         out[k + N / 2] = p - q;
     }
 }
+
+FftPlan::FftPlan(std::size_t size) : _size(size)
+{
+    using namespace std::numbers;
+
+    if (size == 0 || !std::has_single_bit(size)) {
+        throw std::invalid_argument("FFT size must be a power of two");
+    }
+
+    _tw_re.resize(size / 2);
+    _tw_im.resize(size / 2);
+    for (std::size_t k = 0; k < size / 2; k++) {
+        double phi = -2.0 * pi * double(k) / double(size);
+        _tw_re[k] = std::cos(phi);
+        _tw_im[k] = std::sin(phi);
+    }
+
+    const int bits = std::countr_zero(size);
+    _bitrev.resize(size);
+    for (std::size_t i = 0; i < size; i++) {
+        uint32_t r = 0;
+        for (int b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        _bitrev[i] = r;
+    }
+}
+
+void FftPlan::butterflies(std::complex<float>* out, bool inverse) const
+{
+    auto data = reinterpret_cast<float*>(out);
+    const float sign = inverse ? -1.0f : 1.0f;
+
+    for (std::size_t half = 1; half < _size; half *= 2) {
+        const std::size_t stride = _size / (2 * half);
+        for (std::size_t start = 0; start < _size; start += 2 * half) {
+            float* p = data + 2 * start;
+            float* q = data + 2 * (start + half);
+            // Written out in real arithmetic, complex multiplication
+            // would otherwise check for infinities and not vectorize.
+            for (std::size_t k = 0; k < half; k++) {
+                float w_re = _tw_re[k * stride];
+                float w_im = sign * _tw_im[k * stride];
+                float q_re = q[2 * k] * w_re - q[2 * k + 1] * w_im;
+                float q_im = q[2 * k] * w_im + q[2 * k + 1] * w_re;
+                q[2 * k] = p[2 * k] - q_re;
+                q[2 * k + 1] = p[2 * k + 1] - q_im;
+                p[2 * k] += q_re;
+                p[2 * k + 1] += q_im;
+            }
+        }
+    }
+}
+
+static void bitrev_permute(const std::vector<uint32_t>& bitrev,
+        const std::complex<float>* in, std::complex<float>* out)
+{
+    if (in == out) {
+        for (std::size_t i = 0; i < bitrev.size(); i++) {
+            if (i < bitrev[i]) {
+                std::swap(out[i], out[bitrev[i]]);
+            }
+        }
+    } else {
+        for (std::size_t i = 0; i < bitrev.size(); i++) {
+            out[i] = in[bitrev[i]];
+        }
+    }
+}
+
+void FftPlan::forward(const std::complex<float>* in, std::complex<float>* out) const
+{
+    bitrev_permute(_bitrev, in, out);
+    butterflies(out, false);
+}
+
+void FftPlan::inverse(const std::complex<float>* in, std::complex<float>* out) const
+{
+    bitrev_permute(_bitrev, in, out);
+    butterflies(out, true);
+}
@@ -4,6 +4,7 @@
 #include <vector>
 #include <complex>
 #include <algorithm>
+#include <cstdint>
 
 template <bool IsConst>
 struct fft_view_container {};
@@ -67,4 +68,46 @@ using FftView = FftViewTemplate<false>;
 
 void ditfft2(CFftView in, FftView out);
 
+/**
+ * A precomputed radix-2 FFT of a fixed size.
+ *
+ * Holds the twiddle factors and the bit reversal permutation, so that
+ * repeated transforms of the same size do not need to recompute them.
+ * A plan is immutable after construction and can be shared between
+ * threads.
+ */
+class FftPlan {
+    std::size_t _size;
+    std::vector<float> _tw_re;
+    std::vector<float> _tw_im;
+    std::vector<uint32_t> _bitrev;
+
+    void butterflies(std::complex<float>* out, bool inverse) const;
+
+public:
+    /**
+     * ctor.
+     *
+     * size must be a power of two.
+     */
+    explicit FftPlan(std::size_t size);
+
+    std::size_t size() const { return _size; }
+
+    /**
+     * Computes the DFT of size() samples from in and writes it to out.
+     *
+     * in and out may be the same array.
+     */
+    void forward(const std::complex<float>* in, std::complex<float>* out) const;
+
+    /**
+     * Computes the unnormalized inverse DFT, the result is size() times
+     * the inverse transform.
+     *
+     * in and out may be the same array.
+     */
+    void inverse(const std::complex<float>* in, std::complex<float>* out) const;
+};
+
 #endif /* WFALL_FFT_H */
@@ -1,4 +1,6 @@
 #include "fftseq.h"
+#include "feed.h"
+#include <algorithm>
 #include <numbers>
 
 void bswap2(char* ptr)
@@ -8,6 +10,13 @@ void bswap2(char* ptr)
     ptr[1] = tmp;
 }
 
+void bswap3(char* ptr)
+{
+    char tmp = ptr[0];
+    ptr[0] = ptr[2];
+    ptr[2] = tmp;
+}
+
 void bswap4(char* ptr)
 {
     char tmp0 = ptr[0];
@@ -18,37 +27,137 @@ void bswap4(char* ptr)
     ptr[3] = tmp0;
 }
 
-std::vector<float> blackman(std::size_t N)
+void decode_s24_3le(const unsigned char* in, float* out, std::size_t n)
 {
-    using namespace std::numbers;
+    const float norm = 1.0f / 8388608.0f;
+    for (std::size_t i = 0; i < n; i++) {
+        // Assemble the sample in the top 24 bits so that the arithmetic
+        // shift sign extends it.
+        int32_t sample = (int32_t) ((uint32_t) in[3 * i] << 8
+                | (uint32_t) in[3 * i + 1] << 16
+                | (uint32_t) in[3 * i + 2] << 24);
+        out[i] = (float) (sample >> 8) * norm;
+    }
+}
 
-    static const float a0 = 0.42f;
-    static const float a1 = 0.50f;
-    static const float a2 = 0.50f;
+void decode_u8(const unsigned char* in, float* out, std::size_t n)
+{
+    const float norm = 1.0f / 127.5f;
+    for (std::size_t i = 0; i < n; i++) {
+        out[i] = (float) in[i] * norm - 1.0f;
+    }
+}
+
+void weighted_fold(const std::complex<float>* in, const float* weights,
+        std::size_t size, std::size_t taps, std::complex<float>* out)
+{
+    auto in_f = reinterpret_cast<const float*>(in);
+    auto out_f = reinterpret_cast<float*>(out);
+    const std::size_t n = 2 * size;
 
-    std::vector<float> win(N);
+    for (std::size_t j = 0; j < n; j++) {
+        out_f[j] = in_f[j] * weights[j];
+    }
 
-    for (std::size_t n = 1; n < N + 1; ++n) {
-        win[n - 1] = a0 - a1 * std::cos((2.0f * pi_v<float> * n) / N)
-            + a2 * std::cos((4.0f * pi_v<float> * n) / N);
+    for (std::size_t t = 1; t < taps; t++) {
+        const float* x = in_f + t * n;
+        const float* w = weights + t * n;
+        for (std::size_t j = 0; j < n; j++) {
+            out_f[j] += x[j] * w[j];
+        }
     }
+}
 
-    return win;
+void power_spectrum(const std::complex<float>* fft, std::size_t size, bool shift,
+        float norm, float* out)
+{
+    // std::complex<float> is layout compatible with float[2], plain
+    // floats let the loops vectorize.
+    const float* in = reinterpret_cast<const float*>(fft);
+    const std::size_t half = size / 2;
+
+    auto power = [norm](const float* in, float* out, std::size_t n) {
+        for (std::size_t i = 0; i < n; i++) {
+            out[i] = norm * (in[2 * i] * in[2 * i] + in[2 * i + 1] * in[2 * i + 1]);
+        }
+    };
+
+    if (shift) {
+        power(in + 2 * half, out, half);
+        power(in, out + half, half);
+    } else {
+        power(in, out, half);
+    }
 }
 
-std::vector<float> rectangular(std::size_t N)
+FftSeq::Setup::Setup(const Config& config, std::size_t queue, bool two_sided, float psd_rate)
+    : config(config), length(config.fft_size * config.pfb_taps),
+      bins(two_sided ? config.fft_size : config.fft_size / 2), plan(config.fft_size)
 {
-    return std::vector<float>(N, 1.0f);
+    // The constant-Q kernel windows the frame itself.
+    const bool constant_q = config.cqt.min_freq > 0.0f;
+    if (constant_q && two_sided) {
+        throw std::invalid_argument("The constant-Q transform needs a one-sided spectrum");
+    }
+    WindowSpec spec = constant_q ? WindowSpec{WindowType::Rectangular} : config.window;
+    check_axis(config.axis, two_sided);
+
+    window = window_table(spec, config.fft_size, config.pfb_taps);
+    weights.resize(2 * length);
+    for (std::size_t i = 0; i < length; i++) {
+        weights[2 * i] = window->weights[i];
+        weights[2 * i + 1] = window->weights[i];
+    }
+
+    // The one-sided spectrum folds the negative frequencies onto the
+    // positive ones. Amplitudes are corrected for the coherent gain, so
+    // that a tone centered in a bin reads its power whatever the window,
+    // and densities for the noise gain of the window.
+    const double fold = two_sided ? 1.0 : 2.0;
+    if (psd_rate > 0.0f) {
+        norm = fold / (psd_rate * window->power());
+    } else {
+        norm = fold * fold / (window->sum() * window->sum());
+    }
+
+    // The kernel of every bin is normalized to unit sum, like the
+    // windows above, but has its own noise gain.
+    if (constant_q) {
+        cqt = cqt_kernel(config.cqt, config.fft_size, config.window);
+        bins = cqt->bins();
+        cqt_norm.resize(bins);
+        for (std::size_t k = 0; k < bins; k++) {
+            cqt_norm[k] = psd_rate > 0.0f ? fold / (psd_rate * cqt->noise_gain[k]) : fold * fold;
+        }
+    }
+
+    if (config.axis.width > 0) {
+        rebin = rebin_matrix(config.axis, config.fft_size, two_sided);
+        bins = config.axis.width;
+    }
+
+    // Frames that overlap are read in place, until their slot is reused,
+    // by which time queue more FFTs have been read after them. Frames
+    // with gaps between them are copied out, so the gaps are not held.
+    span = config.spacing < 0 ? length + queue * (length + config.spacing) : length;
 }
 
-FftSeq::FftSeq(Stream& stream, std::size_t fft_size, const WinFn& win_fn)
-    : _stream(stream), _fft_size(fft_size), _window_fn(win_fn), _done(false) {}
+FftSeq::FftSeq(Stream& stream, std::size_t fft_size, const WindowSpec& window)
+    : _own_feed(std::make_unique<SampleFeed>(stream)), _feed(*_own_feed),
+      _config{fft_size, 1, 0, window, CqtSpec{}, AxisSpec{}},
+      _frames(std::make_unique<SlotRing<Frame>>(DEFAULT_QUEUE_DEPTH)) {}
+
+FftSeq::FftSeq(SampleFeed& feed, std::size_t fft_size, const WindowSpec& window)
+    : _feed(feed), _config{fft_size, 1, 0, window, CqtSpec{}, AxisSpec{}},
+      _frames(std::make_unique<SlotRing<Frame>>(DEFAULT_QUEUE_DEPTH)) {}
 
 FftSeq::~FftSeq()
 {
-    _quit = true;
-    _done = false;
-    _done.notify_one();
+    _frames->close();
+    if (_work) {
+        _work->close();
+        _feed.detach(_tap);
+    }
     if (_worker.joinable()) {
         _worker.join();
     }
@@ -56,92 +165,429 @@ FftSeq::~FftSeq()
 
 void FftSeq::start()
 {
+    const std::size_t lanes = this->lanes();
+
+    // Every worker needs an FFT to work on, and one more each keeps
+    // them busy while the commit stage waits for the oldest.
+    _work = std::make_unique<SlotRing<Work>>(std::max<std::size_t>(2 * _workers, 2));
+
+    std::size_t bins = this->bins();
+    for (std::size_t i = 0; i < _work->capacity(); i++) {
+        _work->at(i).spectrum.resize(lanes * fft_size());
+        _work->at(i).power.resize(lanes * bins);
+    }
+    for (std::size_t i = 0; i < _frames->capacity(); i++) {
+        _frames->at(i).power.resize(lanes * bins);
+    }
+
+    if (_workers > 1) {
+        _pool = std::make_unique<ThreadPool>(_workers);
+    } else if (lanes > 1) {
+        _pool = std::make_unique<ThreadPool>(
+                std::min<std::size_t>(lanes, std::thread::hardware_concurrency()));
+    }
+
+    // Attached here rather than on the worker, so that a shared feed can
+    // not run ahead before every FftSeq has told it what it needs.
+    _config_changed = false;
+    _setup = std::make_shared<Setup>(config(), _work->capacity(), _two_sided, _psd_rate);
+    std::tie(_tap, _start_pos) = _feed.attach(_setup->length, _setup->span);
+
     _worker = std::thread(&FftSeq::worker_fn, this);
+    if (_own_feed) {
+        _own_feed->start();
+    }
 }
 
-std::size_t FftSeq::fft_size() const
+FftSeq::Config FftSeq::config() const
+{
+    std::lock_guard lock(_config_mutex);
+    return _config;
+}
+
+void FftSeq::configure(const Config& config)
+{
+    update([&](Config& current) { current = config; });
+}
+
+void FftSeq::update(const std::function<void(Config&)>& fn)
 {
-    return _fft_size;
+    std::lock_guard lock(_config_mutex);
+    Config config = _config;
+    fn(config);
+
+    if (config.fft_size < 2 || !std::has_single_bit(config.fft_size)) {
+        throw std::invalid_argument("The FFT size must be a power of two");
+    }
+    if (config.pfb_taps == 0) {
+        throw std::invalid_argument("A filter bank needs at least one tap");
+    }
+    if (config.spacing <= -int64_t(config.fft_size * config.pfb_taps)) {
+        throw std::invalid_argument("Frames can not overlap by more than their length");
+    }
+    check_axis(config.axis, _two_sided);
+    if (config.cqt.min_freq > 0.0f) {
+        if (config.axis.width > 0) {
+            throw std::invalid_argument("The constant-Q transform has its own frequency axis");
+        }
+        if (_two_sided) {
+            throw std::invalid_argument("The constant-Q transform needs a one-sided spectrum");
+        }
+        if (config.pfb_taps > 1) {
+            throw std::invalid_argument("The constant-Q transform can not use a filter bank");
+        }
+        if (cqt_bins(config.cqt, config.fft_size) == 0) {
+            throw std::invalid_argument("The FFT size is too small for the constant-Q transform");
+        }
+    }
+
+    _config = config;
+    _config_changed = true;
 }
 
-/*
 void FftSeq::fft_size(std::size_t size)
 {
-    _fft_size = size;
+    update([&](Config& config) { config.fft_size = size; });
+}
+
+std::size_t FftSeq::fft_size() const
+{
+    return config().fft_size;
+}
+
+void FftSeq::window(const WindowSpec& window)
+{
+    update([&](Config& config) { config.window = window; });
+}
+
+WindowSpec FftSeq::window() const
+{
+    return config().window;
+}
+
+void FftSeq::cqt(const CqtSpec& cqt)
+{
+    update([&](Config& config) { config.cqt = cqt; });
+}
+
+CqtSpec FftSeq::cqt() const
+{
+    return config().cqt;
+}
+
+void FftSeq::axis(const AxisSpec& axis)
+{
+    update([&](Config& config) { config.axis = axis; });
+}
+
+AxisSpec FftSeq::axis() const
+{
+    return config().axis;
+}
+
+std::size_t FftSeq::lanes() const
+{
+    return _feed.lanes();
+}
+
+void FftSeq::pfb(std::size_t taps)
+{
+    update([&](Config& config) { config.pfb_taps = taps; });
+}
+
+std::size_t FftSeq::pfb() const
+{
+    return config().pfb_taps;
+}
+
+std::size_t FftSeq::frame_size() const
+{
+    Config config = this->config();
+    return config.fft_size * config.pfb_taps;
 }
-*/
 
 void FftSeq::spacing(int spacing)
 {
-    _spacing = spacing;
+    update([&](Config& config) { config.spacing = spacing; });
 }
 
 int FftSeq::spacing() const
 {
-    return _spacing;
+    return config().spacing;
 }
 
 void FftSeq::optimal_spacing(float srate, float fft_rate)
 {
     float samples_per_fft = srate / fft_rate;
-    _spacing = (int) (0.5 + samples_per_fft - _fft_size);
+    update([&](Config& config) {
+        int length = config.fft_size * config.pfb_taps;
+        config.spacing = std::max(1 - length, (int) (0.5 + samples_per_fft - length));
+    });
 }
 
-bool FftSeq::has_next() const
+void FftSeq::workers(std::size_t count)
 {
-    return _done.load();
+    if (count == 0) {
+        throw std::invalid_argument("At least one FFT worker is needed");
+    }
+    _workers = count;
 }
 
-std::vector<std::complex<float>>&& FftSeq::next()
+std::size_t FftSeq::workers() const
 {
-    return std::move(_result);
+    return _workers;
 }
 
-void FftSeq::notify()
+void FftSeq::two_sided(bool two_sided)
 {
-    _done = false;
-    _done.notify_one();
+    _two_sided = two_sided;
 }
 
-void FftSeq::worker_fn()
+bool FftSeq::two_sided() const
 {
-    std::size_t size = 0;
-    std::vector<float> window;
-    std::vector<std::complex<float>> buffer;
-    while (1) {
-        if (size != _fft_size) {
-            size = _fft_size;
-            window = _window_fn(size);
+    return _two_sided;
+}
 
-            if (_spacing < 0) {
-                buffer = std::vector<std::complex<float>>(size);
-            }
+void FftSeq::psd(float rate)
+{
+    _psd_rate = rate;
+}
+
+float FftSeq::psd() const
+{
+    return _psd_rate;
+}
+
+std::size_t FftSeq::bins() const
+{
+    Config config = this->config();
+    if (config.axis.width > 0) {
+        return config.axis.width;
+    }
+    if (config.cqt.min_freq > 0.0f) {
+        return cqt_bins(config.cqt, config.fft_size);
+    }
+    return _two_sided ? config.fft_size : config.fft_size / 2;
+}
+
+void FftSeq::average(AverageMode mode, std::size_t count, float alpha)
+{
+    _averager = Averager(mode, count, alpha);
+}
+
+void FftSeq::queue_depth(std::size_t depth)
+{
+    _frames = std::make_unique<SlotRing<Frame>>(depth);
+}
+
+std::size_t FftSeq::queue_depth() const
+{
+    return _frames->capacity();
+}
+
+std::size_t FftSeq::frames_skipped() const
+{
+    return _frames_skipped.load();
+}
+
+bool FftSeq::has_next()
+{
+    return _frames->borrow() != nullptr;
+}
+
+const Frame& FftSeq::next()
+{
+    return *_frames->borrow();
+}
+
+const Frame* FftSeq::wait_next()
+{
+    return _frames->wait_borrow();
+}
+
+void FftSeq::release()
+{
+    _frames->release();
+}
+
+void FftSeq::transform(uint64_t seq, Work& work)
+{
+    const Setup& setup = *work.setup;
+    const std::size_t lanes = this->lanes();
+    const std::size_t size = setup.config.fft_size;
+
+    work.info.compute_start = Stream::Clock::now();
+
+    auto lane = [&](std::size_t l) {
+        std::complex<float>* spectrum = work.spectrum.data() + l * size;
+        const std::complex<float>* input = work.history
+            ? work.history->frame(l, work.start)
+            : work.input.data() + l * setup.length;
+        weighted_fold(input, setup.weights.data(), size,
+                setup.config.pfb_taps, spectrum);
+        setup.plan.forward(spectrum, spectrum);
+
+        float* power = work.power.data() + l * setup.bins;
+        if (setup.cqt) {
+            setup.cqt->power(spectrum, setup.cqt_norm.data(), power);
+            return;
+        }
+
+        // Rebinned spectra go through the linear buffer first.
+        const std::size_t linear_bins = _two_sided ? size : size / 2;
+        float* linear = setup.rebin.rows() > 0 ? work.linear.data() + l * linear_bins : power;
+
+        power_spectrum(spectrum, size, _two_sided, setup.norm, linear);
+        if (_psd_rate > 0.0f && !_two_sided) {
+            // Zero frequency has no negative counterpart.
+            linear[0] *= 0.5f;
+        }
+
+        if (setup.rebin.rows() > 0) {
+            setup.rebin.multiply(linear, power);
+        }
+    };
+
+    if (_pool && lanes > 1) {
+        _pool->parallel_for(lanes, lane);
+    } else {
+        lane(0);
+    }
+
+    work.info.compute_end = Stream::Clock::now();
+
+    _work->publish(seq);
+    commit();
+}
+
+void FftSeq::commit()
+{
+    // Every worker tries to commit after publishing, so each FFT is
+    // taken by the worker that publishes it or by one that came later.
+    std::lock_guard lock(_commit_mutex);
+
+    while (const Work* work = _work->borrow()) {
+        // A new bin count restarts the average.
+        std::size_t bins = work->setup->bins;
+        if (_out_ffts > 0 && _averager.result().size() != work->power.size()) {
+            _out_ffts = 0;
+        }
+
+        if (_out_ffts == 0) {
+            _out_info = work->info;
+        } else {
+            _out_info.last_arrival = work->info.last_arrival;
+            _out_info.compute_start = work->info.compute_start;
+            _out_info.compute_end = work->info.compute_end;
+        }
+        _out_ffts++;
+
+        bool complete = _averager.add(work->power);
+        _work->release();
+
+        if (!complete) {
+            continue;
         }
 
-        std::vector<std::complex<float>> in_vec;
+        _out_info.ffts = _out_ffts;
+        _out_ffts = 0;
 
-        if (_spacing >= 0) {
-            _stream.skip(_spacing);
-            in_vec = _stream.read_chunk(size);
-        } else if (_spacing < 0) {
-            std::move(buffer.end() + _spacing, buffer.end(), buffer.begin());
-            auto tmp = _stream.read_chunk(size + _spacing);
-            std::copy_n(tmp.begin(), tmp.size(), buffer.begin());
-            in_vec = buffer;
+        Frame* frame = _frames->acquire(_out_seq);
+        if (frame == nullptr) {
+            return;
         }
 
-        for (std::size_t i = 0; i < size; i++) {
-            in_vec[i] *= window[i];
+        auto result = _averager.result();
+        frame->power.assign(result.begin(), result.end());
+        frame->bins = bins;
+        frame->info = _out_info;
+        _frames->publish(_out_seq++);
+    }
+}
+
+void FftSeq::worker_fn()
+{
+    std::shared_ptr<Setup> setup = _setup;
+
+    // Position of the sample after the previous frame.
+    int64_t pos = _start_pos;
+    bool skipped = false;
+
+    uint64_t seq = 0;
+    for (; ; seq++) {
+        Work* work = _work->acquire(seq);
+        if (work == nullptr) {
+            return;
+        }
+
+        if (_config_changed.exchange(false)) {
+            setup = std::make_shared<Setup>(config(), _work->capacity(), _two_sided, _psd_rate);
+            _feed.reserve(_tap, setup->length, setup->span);
+        }
+
+        // While the input is behind, every other frame is skipped by
+        // moving on a whole frame spacing, so the frames stay in phase.
+        // The feed skips the samples that no frame reads.
+        skipped = !skipped && _feed.behind();
+        if (skipped) {
+            pos += setup->length + setup->config.spacing;
+            _frames_skipped++;
         }
 
-        _result.resize(size);
-        ditfft2(in_vec, _result);
+        const int64_t start = pos + setup->config.spacing;
+        const int64_t end = start + setup->length;
 
-        if (_quit) {
+        // The FFTs that have not been committed yet still read their
+        // input from the history, unless it was copied out. The older
+        // ones are done with it.
+        int64_t keep = start;
+        for (uint64_t s = _work->released(); s < seq; s++) {
+            if (_work->at(s).history) {
+                keep = std::min(keep, _work->at(s).start);
+            }
+        }
+
+        // Negative for the first overlapping frames, which read the zeros
+        // from before the stream.
+        auto history = _feed.wait(_tap, start, end, keep);
+        if (history == nullptr) {
             break;
         }
+        pos = end;
+
+        work->setup = setup;
+        work->start = start;
+        if (setup->config.spacing < 0) {
+            work->history = std::move(history);
+        } else {
+            work->history = nullptr;
+            work->input.resize(lanes() * setup->length);
+            for (std::size_t l = 0; l < lanes(); l++) {
+                std::copy_n(history->frame(l, start), setup->length,
+                        work->input.data() + l * setup->length);
+            }
+        }
+        work->spectrum.resize(lanes() * setup->config.fft_size);
+        work->power.resize(lanes() * setup->bins);
+        if (setup->rebin.rows() > 0) {
+            work->linear.resize(lanes() * setup->rebin.cols());
+        }
+
+        FrameInfo& info = work->info;
+        info.index = start;
+        info.first_arrival = _feed.arrival(start);
+        info.last_arrival = _feed.arrival(end - 1);
+
+        if (_workers > 1) {
+            _pool->submit([this, seq, work] { transform(seq, *work); });
+        } else {
+            transform(seq, *work);
+        }
+    }
 
-        _done = true;
-        _done.wait(true);
+    // The input has ended. The consumer is told once the FFTs in flight
+    // have been committed.
+    if (_work->wait_released(seq)) {
+        _frames->close();
     }
 }
@@ -11,19 +11,64 @@
 #include <functional>
 #include <thread>
 #include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+#include <chrono>
+#include <deque>
+#include <mutex>
 
 #include "fft.h"
+#include "threadpool.h"
+#include "ring.h"
+#include "history.h"
+#include "average.h"
+#include "window.h"
+#include "cqt.h"
+#include "rebin.h"
 
 /**
  * Byteorder swap for 2-byte ints.
  */
 void bswap2(char* ptr);
 
+/**
+ * Byteorder swap for 3-byte ints.
+ */
+void bswap3(char* ptr);
+
 /**
  * Byteorder swap for 4-byte ints.
  */
 void bswap4(char* ptr);
 
+/**
+ * A packed 24-bit signed sample (S24_3).
+ *
+ * The bytes are stored in native byte order, so that a PcmStream can
+ * byteswap them like any other sample format.
+ */
+struct int24_3 {
+    unsigned char bytes[3];
+};
+
+static_assert(sizeof(int24_3) == 3, "int24_3 must be packed");
+
+/**
+ * Decodes n signed 24-bit packed little-endian samples to floats.
+ */
+void decode_s24_3le(const unsigned char* in, float* out, std::size_t n);
+
+/**
+ * Decodes n unsigned 8-bit samples to floats.
+ *
+ * This is the format used by RTL-SDR style IQ sources, where 127.5
+ * encodes zero.
+ */
+void decode_u8(const unsigned char* in, float* out, std::size_t n);
+
 /**
  * An abstract base class for an input stream to an FftSeq.
  *
@@ -32,15 +77,47 @@ void bswap4(char* ptr);
  */
 struct Stream {
     using OutSample = std::complex<float>;
+    using Clock = std::chrono::steady_clock;
+
+    virtual ~Stream() = default;
+
+    /**
+     * Returns the number of independent signals (lanes) in the stream.
+     *
+     * Most streams combine each multichannel frame into a single
+     * complex number and have one lane. A stream with several lanes
+     * carries one signal per input channel.
+     */
+    virtual std::size_t lanes() const { return 1; }
 
     /**
      * Read count frames.
      *
      * For multichannel data each frame (consisting of one sample for
      * each channel) must be processed in some way to yield a single
-     * complex number.
+     * complex number per lane. count samples are written to each of the
+     * lanes() buffers in out.
+     */
+    virtual void read(OutSample* const* out, std::size_t count) = 0;
+
+    /**
+     * Read count frames into a new vector.
+     *
+     * The returned vector holds count * lanes() samples, with all
+     * samples of lane 0 first, then lane 1 and so on.
      */
-    virtual std::vector<OutSample> read_chunk(std::size_t count) = 0;
+    std::vector<OutSample> read_chunk(std::size_t count)
+    {
+        std::vector<OutSample> out(count * lanes());
+        std::vector<OutSample*> ptrs(lanes());
+        for (std::size_t l = 0; l < ptrs.size(); l++) {
+            ptrs[l] = out.data() + l * count;
+        }
+
+        read(ptrs.data(), count);
+
+        return out;
+    }
 
     /**
      * Skip count frames.
@@ -49,17 +126,45 @@ struct Stream {
      * than to simply ignore output from Stream::read.
      */
     virtual void skip(std::size_t count) = 0;
+
+    /**
+     * Returns the time at which the newest sample that was read or
+     * skipped arrived.
+     *
+     * Sources record when they got the data from the operating system,
+     * streams that process another stream report the arrival of their
+     * source. Streams that do not know return the current time.
+     */
+    virtual Clock::time_point arrival() const { return Clock::now(); }
+
+    /**
+     * Returns true once a read or skip has run into the end of the input.
+     * The samples past the end read as zeros.
+     *
+     * Live sources never end. Streams that process another stream end
+     * with it.
+     */
+    virtual bool eof() const { return false; }
+
+    /**
+     * Returns true if the consumer has fallen behind the input and should
+     * skip frames to catch up, see DropPolicy::Decimate.
+     *
+     * Streams that process another stream forward it from their source.
+     */
+    virtual bool behind() const { return false; }
 };
 
 /**
  * Parses PCM data.
  *
  * The sample format is specified with a template parameter.
- * PcmStream has three ways of handling multichannel data:
+ * PcmStream has four ways of handling multichannel data:
  * solo: the output stream is one of the channels from the input.
  * mix: the output stream is the average of the input channels.
  * iq: the real part of the output is the first channel and the
  * imaginary part of the output is the second channel.
+ * multi: each channel is deinterleaved into a lane of its own.
  *
  * The term frame is used to mean a sequence of n samples where n is
  * the number of channels in the stream. The frame is aligned so that
@@ -73,11 +178,22 @@ class PcmStream : public Stream {
     std::size_t _channels = 1;
     std::endian _endian = std::endian::little;
 
-    std::size_t _solo;
-    bool _mix;
-    bool _iq;
+    std::size_t _solo = 0;
+    bool _mix = false;
+    bool _iq = false;
+    bool _multi = false;
 
     std::vector<char> buf;
+    std::vector<float> _decoded;
+    std::vector<char> _discard;
+    bool _seekable = true;
+    Clock::time_point _arrival = Clock::now();
+
+    /**
+     * Size of the chunks that skipped input is discarded in when the
+     * input can not seek.
+     */
+    static constexpr std::size_t DISCARD_CHUNK = 1 << 16;
 
 public:
     /**
@@ -110,7 +226,7 @@ public:
     /**
      * Returns true if the PcmStream is in solo mode.
      */
-    bool is_solo() const { return _mix || _iq; }
+    bool is_solo() const { return !(_mix || _iq || _multi); }
 
     /**
      * Getter for the selected solo channel.
@@ -130,6 +246,7 @@ public:
         _solo = ch;
         _mix = false;
         _iq = false;
+        _multi = false;
     }
 
     /**
@@ -143,6 +260,7 @@ public:
     void mix() {
         _mix = true;
         _iq = false;
+        _multi = false;
     }
 
     /**
@@ -162,8 +280,28 @@ public:
         }
         _iq = true;
         _mix = false;
+        _multi = false;
+    }
+
+    /**
+     * Returns true if the PcmStream is in multi mode
+     */
+    bool is_multi() const { return _multi; }
+
+    /**
+     * Sets the PcmStream to multi mode.
+     *
+     * Every channel is output as a separate lane.
+     */
+    void multi()
+    {
+        _multi = true;
+        _mix = false;
+        _iq = false;
     }
 
+    std::size_t lanes() const override { return _multi ? _channels : 1; }
+
 private:
     /**
      * Swaps the bytes in buffer, depending on the sample width.
@@ -174,6 +312,10 @@ private:
             for (std::size_t i = 0; i < size; i += 2) {
                 bswap2(buffer + i);
             }
+        } else if (sizeof(Sample) == 3) {
+            for (std::size_t i = 0; i < size; i += 3) {
+                bswap3(buffer + i);
+            }
         } else if (sizeof(Sample) == 4) {
             for (std::size_t i = 0; i < size; i += 4) {
                 bswap4(buffer + i);
@@ -192,54 +334,97 @@ private:
      * maximum value and subtracting 1.0f. Samples encoding amplitude
      * zero are handled correctly.
      */
-    float pcm_convert(Sample sample)
+    static float pcm_convert(Sample sample)
     {
         if constexpr (std::is_floating_point_v<Sample>) {
             return sample;
         } else if constexpr (std::is_signed_v<Sample>) {
             return (float) sample / -((float) std::numeric_limits<Sample>::min());
         } else {
-            return (float) sample / (float) (std::numeric_limits<Sample>::max() / 2) - 1.0f;
+            return (float) sample / ((float) std::numeric_limits<Sample>::max() / 2.0f) - 1.0f;
         }
     }
 
     /**
-     * Parses a pcm frame, returning the average of all channels.
+     * Decodes n samples in buffer (already in native byte order) to
+     * normalized floats.
+     *
+     * The loops are kept free of branches and data dependent control
+     * flow so that the compiler can vectorize them.
      */
-    OutSample parse_mix(char *ptr)
+    void decode(const char *buffer, float *out, std::size_t n)
     {
-        OutSample out_sample = 0.0f;
-        for (std::size_t c = 0; c < _channels; c++) {
-            Sample in_sample = *reinterpret_cast<Sample*>(ptr + c * sizeof(Sample));
-            out_sample += pcm_convert(in_sample);
+        auto bytes = reinterpret_cast<const unsigned char*>(buffer);
+
+        if constexpr (std::is_same_v<Sample, int24_3>) {
+            static_assert(std::endian::native == std::endian::little,
+                    "int24_3 decoding requires a little-endian host");
+            decode_s24_3le(bytes, out, n);
+        } else if constexpr (std::is_same_v<Sample, uint8_t>) {
+            decode_u8(bytes, out, n);
+        } else {
+            for (std::size_t i = 0; i < n; i++) {
+                Sample sample;
+                std::memcpy(&sample, buffer + i * sizeof(Sample), sizeof(Sample));
+                out[i] = pcm_convert(sample);
+            }
         }
+    }
 
-        return out_sample / float(_channels);
+    /**
+     * Combines decoded frames into their average over all channels.
+     */
+    void parse_mix(const float *in, OutSample *out, std::size_t count)
+    {
+        const float norm = 1.0f / float(_channels);
+        for (std::size_t i = 0; i < count; i++) {
+            float sum = 0.0f;
+            for (std::size_t c = 0; c < _channels; c++) {
+                sum += in[i * _channels + c];
+            }
+            out[i] = sum * norm;
+        }
     }
 
     /**
-     * Parses a pcm frame, returning the frame interpreted as an iq
-     * sample.
+     * Combines decoded frames into iq samples, using the first channel
+     * as the real part and the second channel as the imaginary part.
      */
-    OutSample parse_iq(char *ptr)
+    void parse_iq(const float *in, OutSample *out, std::size_t count)
     {
-        OutSample out_sample = 0.0f;
+        if (_channels == 2) {
+            // std::complex<float> is layout compatible with float[2].
+            std::memcpy(static_cast<void*>(out), in, count * sizeof(OutSample));
+            return;
+        }
 
-        Sample in_sample = *reinterpret_cast<Sample*>(ptr);
-        out_sample.real(pcm_convert(in_sample));
-        in_sample = *reinterpret_cast<Sample*>(ptr + sizeof(Sample));
-        out_sample.imag(pcm_convert(in_sample));
+        for (std::size_t i = 0; i < count; i++) {
+            out[i] = OutSample(in[i * _channels], in[i * _channels + 1]);
+        }
+    }
 
-        return out_sample;
+    /**
+     * Picks the solo channel from each of the decoded frames.
+     */
+    void parse_solo(const float *in, OutSample *out, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i++) {
+            out[i] = in[i * _channels + _solo];
+        }
     }
 
     /**
-     * Parses one of samples in a frame and returns its amplitude.
+     * Deinterleaves the decoded frames, writing each channel to its own
+     * lane.
      */
-    OutSample parse_solo(char *ptr)
+    void parse_multi(const float *in, OutSample* const* out, std::size_t count)
     {
-        Sample in_sample = *reinterpret_cast<Sample*>(ptr + _solo * sizeof(Sample));
-        return pcm_convert(in_sample);
+        for (std::size_t c = 0; c < _channels; c++) {
+            OutSample *lane = out[c];
+            for (std::size_t i = 0; i < count; i++) {
+                lane[i] = in[i * _channels + c];
+            }
+        }
     }
 
 public:
@@ -247,10 +432,10 @@ public:
      * Read a chunk of pcm data and convert it to floating point.
      *
      * Reads count frames from the stream, decoding each and
-     * returns a vector containing complex numbers that are
-     * the input for an fft.
+     * writing the complex numbers that are the input for an fft
+     * to out.
      */
-    std::vector<OutSample> read_chunk(std::size_t count) override
+    void read(OutSample* const* out, std::size_t count) override
     {
         std::size_t total_size = count * _channels * sizeof(Sample);
 
@@ -259,94 +444,475 @@ public:
         }
 
         _input.read(buf.data(), total_size);
+        const std::size_t got = _input.gcount();
+        _arrival = Clock::now();
 
         if (_endian != std::endian::native) {
             bswap_buffer(buf.data(), total_size);
         }
 
-        std::vector<OutSample> out;
-        out.reserve(count);
-        for (std::size_t i = 0; i < count; i++) {
-            char *ptr = buf.data() + i * _channels * sizeof(Sample);
-
-            if (_mix) {
-                out.push_back(parse_mix(ptr));
-            } else if (_iq) {
-                out.push_back(parse_iq(ptr));
-            } else {
-                out.push_back(parse_solo(ptr));
-            }
+        _decoded.resize(count * _channels);
+        decode(buf.data(), _decoded.data(), _decoded.size());
+        if (got < total_size) {
+            // Past the end of the input.
+            std::fill(_decoded.begin() + got / sizeof(Sample), _decoded.end(), 0.0f);
         }
 
-        return out;
+        if (_multi) {
+            parse_multi(_decoded.data(), out, count);
+        } else if (_mix) {
+            parse_mix(_decoded.data(), out[0], count);
+        } else if (_iq) {
+            parse_iq(_decoded.data(), out[0], count);
+        } else {
+            parse_solo(_decoded.data(), out[0], count);
+        }
     }
 
     /**
      * Skip count frames of input data.
+     *
+     * Seeks past the data if the input supports it. Otherwise, for
+     * example when reading from a pipe, the data is read and discarded
+     * in large chunks.
      */
     void skip(std::size_t count) override
     {
         std::size_t total_size = count * _channels * sizeof(Sample);
-        _input.ignore(total_size);
+        if (total_size == 0) {
+            return;
+        }
+
+        if (_seekable) {
+            if (_input.seekg(total_size, std::ios::cur)) {
+                // Files can be seeked past their end, which only shows
+                // when the next byte is looked at.
+                _input.peek();
+                _arrival = Clock::now();
+                return;
+            }
+
+            // Seeking failed, so it will fail the next time too.
+            _input.clear(_input.rdstate() & ~std::ios::failbit);
+            _seekable = false;
+        }
+
+        _discard.resize(std::min(total_size, DISCARD_CHUNK));
+        while (total_size > 0 && _input) {
+            std::size_t n = std::min(total_size, _discard.size());
+            _input.read(_discard.data(), n);
+            total_size -= n;
+        }
+        _arrival = Clock::now();
     }
+
+    Clock::time_point arrival() const override { return _arrival; }
+
+    bool eof() const override { return _input.eof(); }
 };
 
-std::vector<float> blackman(std::size_t N);
-std::vector<float> rectangular(std::size_t N);
+/**
+ * Weights taps * size samples from in and folds them into size samples.
+ *
+ * weights holds the real weights with every value repeated twice, once
+ * for the real and once for the imaginary part, so that the loop runs
+ * over plain floats and vectorizes.
+ */
+void weighted_fold(const std::complex<float>* in, const float* weights,
+        std::size_t size, std::size_t taps, std::complex<float>* out);
+
+/**
+ * Timing metadata of an FFT frame.
+ */
+struct FrameInfo {
+    /**
+     * Index in the stream of the first sample of the frame. Negative for
+     * the first overlapping frames, which start with zeros from before
+     * the stream.
+     */
+    int64_t index = 0;
+    /** Arrival of the first and the last sample, see Stream::arrival. */
+    Stream::Clock::time_point first_arrival;
+    Stream::Clock::time_point last_arrival;
+    /** When the computation of the FFTs started and ended. */
+    Stream::Clock::time_point compute_start;
+    Stream::Clock::time_point compute_end;
+    /**
+     * The number of FFTs averaged into the frame. index and
+     * first_arrival describe the first of them, the other fields the
+     * last.
+     */
+    std::size_t ffts = 1;
+};
+
+/**
+ * The power spectra of an FFT frame, one per lane, and its metadata.
+ */
+struct Frame {
+    /** bins power values per lane, with all of lane 0 first. */
+    std::vector<float> power;
+    std::size_t bins = 0;
+    FrameInfo info;
+};
+
+class SampleFeed;
+
+/**
+ * Computes the power of the bins of an FFT of the given size, scaled by
+ * norm.
+ *
+ * With shift set, all size bins are written, reordered so that zero
+ * frequency is in the middle. Otherwise only the size / 2 bins of the
+ * positive half are written.
+ */
+void power_spectrum(const std::complex<float>* fft, std::size_t size, bool shift,
+        float norm, float* out);
 
 /**
  * Asynchronously computes consecutive FFTs of a signal.
  *
- * Uses a thread for FFT computation and I/O. Applies the chosen window
+ * Uses a thread for I/O and FFT computation. Applies the chosen window
  * function to the input data before running the FFT.
  * The basic usage is as following:
  *
  * FftSeq fft_seq(...);
  * fft_seq.start();
  * while (...) {
- *   if (fft_seq.has_next()) {
- *     // Move the fft to v.
- *     auto v = fft_seq.next();
- *     // Notify thread to start working again.
- *     fft_seq.notify();
+ *   while (fft_seq.has_next()) {
+ *     // Borrow the oldest frame.
+ *     const Frame& frame = fft_seq.next();
+ *     ...
+ *     // Hand its buffer back to the thread.
+ *     fft_seq.release();
  *   }
  * }
  *
- * After finishing its computation the thread waits until notify is
- * called.
+ * The frames are computed into a ring of preallocated buffers, so the
+ * thread can run up to queue_depth() frames ahead of the consumer and
+ * absorb stalls in rendering. When the ring is full the thread waits
+ * for release to be called.
+ *
+ * Every frame carries a FrameInfo with the position of its samples in
+ * the stream, when they arrived and when the FFTs were computed, so that
+ * the latency of each stage can be measured.
+ *
+ * The input is read into a SampleHistory, and the FFTs read their frames
+ * from it in place, so overlapping frames cost no copying. The history
+ * holds enough samples that no frame is overwritten before its slot has
+ * been released.
+ *
+ * Each frame holds power spectra, of the positive half of the spectrum
+ * or, with two_sided(), of all of it. By default they are scaled by the
+ * coherent gain of the window, so that a full scale sinusoid centered in
+ * a bin reads 1 (0 dB) whatever the window. With psd() they are power
+ * spectral densities, normalized by the power of the window, so that
+ * noise reads the same whatever the window and FFT size. Overlapping
+ * frames combined with linear averaging then make a Welch estimator.
+ * Consecutive spectra can be averaged with average(), in which case a
+ * frame is only handed to the consumer for every count FFTs.
+ *
+ * With workers() > 1 the thread only reads the input, and the FFTs are
+ * computed in parallel by a pool of workers. The workers may finish out
+ * of order, so the spectra are passed through a commit stage that takes
+ * them in sequence, one worker at a time, to be averaged and handed on.
+ *
+ * If the stream has several lanes, one FFT is computed per lane and the
+ * spectra are stored one after another in the result. The per-lane
+ * transforms are spread over a thread pool.
+ *
+ * The FFT size, window, filter bank taps and spacing can be changed
+ * while running with configure(), without losing any input: the samples
+ * that the new frames overlap with are carried over.
+ *
+ * The input is read through a SampleFeed. An FftSeq made from a stream
+ * has one of its own, while FftSeqs made from the same feed share one
+ * history, so that views of different resolution can be computed from
+ * one input.
+ *
+ * While the stream is behind(), every other frame is skipped, which
+ * halves the work until the consumer has caught up. The frames that are
+ * computed keep their place on the grid of frames, and their
+ * FrameInfo::index counts the skipped samples.
+ *
+ * When the stream ends, the FFTs in flight are finished and handed out,
+ * and then wait_next() returns nullptr. A partial average is dropped.
+ *
+ * In polyphase filter bank mode (pfb() > 1) every FFT frame spans
+ * several FFT lengths of input. The frame is weighted by the long
+ * prototype filter from window_table and folded into fft_size() points
+ * before the transform, which gives much less leakage between bins than
+ * a plain window of the same FFT size.
+ *
+ * With a constant-Q transform (Config::cqt) the bins are spaced
+ * logarithmically instead, each with a bandwidth proportional to its
+ * frequency. They are computed from the FFT of the plain frame with a
+ * sparse spectral kernel, see CqtKernel, which applies the window, so the
+ * frame size must hold the longest kernel, see cqt_fft_size. Only the
+ * one-sided spectrum is supported, and not together with a filter bank.
+ *
+ * The linear bins can also be rebinned onto another frequency axis
+ * (Config::axis), such as a mel, Bark or log scale, by a sparse matrix
+ * from rebin_matrix. With the width of the display, it receives just one
+ * bin per pixel.
  */
 class FftSeq {
 public:
-    using WinFn = std::function<std::vector<float>(std::size_t)>;
+    /**
+     * The settings that can be changed while the FftSeq is running.
+     */
+    struct Config {
+        std::size_t fft_size;
+        std::size_t pfb_taps = 1;
+        int spacing = 0;
+        WindowSpec window;
+        /** Disabled by default. */
+        CqtSpec cqt;
+        /** Disabled by default. */
+        AxisSpec axis;
+    };
 
 private:
-    Stream& _stream;
-    std::size_t _fft_size;
-    int _spacing = 0;
-    WinFn _window_fn;
-    std::vector<std::complex<float>> _result;
+    static constexpr std::size_t DEFAULT_QUEUE_DEPTH = 8;
+
+    /**
+     * Everything derived from a Config. Shared read-only by the FFTs
+     * that use it, so that a new one can be made while they finish.
+     */
+    struct Setup {
+        Config config;
+        std::size_t length;
+        std::size_t bins;
+        /** Scale from |X|^2 to the output power. */
+        float norm;
+        FftPlan plan;
+        std::shared_ptr<const WindowTable> window;
+        /** The prototype filter, every value repeated for re and im. */
+        std::vector<float> weights;
+        /**
+         * Samples from the oldest frame in flight that reads the history
+         * in place to the newest.
+         */
+        std::size_t span;
+        /** The constant-Q kernel and the norm of each of its bins. */
+        std::shared_ptr<const CqtKernel> cqt;
+        std::vector<float> cqt_norm;
+        /** Rebins the linear bins onto the axis, if it has a width. */
+        CsrMatrix<float> rebin;
+
+        Setup(const Config& config, std::size_t queue, bool two_sided, float psd_rate);
+    };
+
+    /**
+     * An FFT in progress.
+     */
+    struct Work {
+        std::shared_ptr<const Setup> setup;
+        /** The history to read the input from, or null if it is in input. */
+        std::shared_ptr<const SampleHistory> history;
+        /** Position of the first input sample. */
+        int64_t start = 0;
+        /** A copy of the input, for frames that do not overlap. */
+        std::vector<std::complex<float>> input;
+        FrameInfo info;
+        std::vector<std::complex<float>> spectrum;
+        /** The linear bins, before they are rebinned. */
+        std::vector<float> linear;
+        std::vector<float> power;
+    };
+
+    std::unique_ptr<SampleFeed> _own_feed;
+    SampleFeed& _feed;
+    /** The SampleFeed::Tap of the FftSeq. */
+    std::size_t _tap = 0;
+    /** The setup and position that the worker starts from. */
+    std::shared_ptr<Setup> _setup;
+    int64_t _start_pos = 0;
+
+    std::size_t _workers = 1;
+    bool _two_sided = false;
+    /** Sample rate for density scaling, 0 for amplitude scaling. */
+    float _psd_rate = 0.0f;
+    Averager _averager;
+
+    /** The newest config, picked up by the worker between frames. */
+    Config _config;
+    mutable std::mutex _config_mutex;
+    std::atomic<bool> _config_changed = false;
+
+    std::atomic<std::size_t> _frames_skipped = 0;
+
+    std::unique_ptr<SlotRing<Work>> _work;
+    std::unique_ptr<SlotRing<Frame>> _frames;
+
+    /** Serializes the commit stage. */
+    std::mutex _commit_mutex;
+    uint64_t _out_seq = 0;
+    FrameInfo _out_info;
+    std::size_t _out_ffts = 0;
     std::thread _worker;
-    std::atomic<bool> _done;
-    bool _quit = false;
+    std::unique_ptr<ThreadPool> _pool;
 
     void worker_fn();
 
+    /**
+     * Computes the power spectra of FFT seq from its input.
+     */
+    void transform(uint64_t seq, Work& work);
+
+    /**
+     * Averages the finished FFTs in sequence and hands the complete
+     * frames to the consumer.
+     */
+    void commit();
+
+    /**
+     * Applies fn to the config under the lock and checks the result.
+     */
+    void update(const std::function<void(Config&)>& fn);
+
 public:
-    FftSeq(Stream& stream, std::size_t fft_size, const WinFn& win_fn = blackman);
+    FftSeq(Stream& stream, std::size_t fft_size, const WindowSpec& window = {});
+
+    /**
+     * ctor. Reads the input from feed, which may be shared with other
+     * FftSeqs and is started separately.
+     */
+    FftSeq(SampleFeed& feed, std::size_t fft_size, const WindowSpec& window = {});
     ~FftSeq();
 
     void start();
 
+    /**
+     * Returns the newest config.
+     */
+    Config config() const;
+
+    /**
+     * Replaces the config. While running, the worker switches to it
+     * between two frames, so all changes take effect on the same frame.
+     * Frames of the old and the new config can still be in the queue,
+     * and Frame::bins tells them apart.
+     *
+     * Throws std::invalid_argument if the config is not valid.
+     */
+    void configure(const Config& config);
+
+    /**
+     * The setters below change one setting of the config each, see
+     * configure.
+     */
+    void fft_size(std::size_t size);
     std::size_t fft_size() const;
 
+    void window(const WindowSpec& window);
+    WindowSpec window() const;
+
+    /**
+     * Sets the constant-Q transform, a min_freq of 0 disables it.
+     */
+    void cqt(const CqtSpec& cqt);
+    CqtSpec cqt() const;
+
+    /**
+     * Sets the frequency axis, a width of 0 keeps the linear bins.
+     */
+    void axis(const AxisSpec& axis);
+    AxisSpec axis() const;
+
+    /**
+     * Sets the number of taps of the polyphase filter bank, 1 disables
+     * it.
+     */
+    void pfb(std::size_t taps);
+    std::size_t pfb() const;
+
+    /**
+     * Returns the number of input samples that each FFT is computed
+     * from, which is fft_size() * pfb().
+     */
+    std::size_t frame_size() const;
+
     void spacing(int spacing);
     int spacing() const;
 
+    /**
+     * Sets the spacing that gives fft_rate FFTs per second for the
+     * current frame size.
+     */
     void optimal_spacing(float srate, float fft_rate);
 
-    bool has_next() const;
-    std::vector<std::complex<float>>&& next();
-    void notify();
+    std::size_t lanes() const;
+
+    /**
+     * Sets the number of threads that compute FFTs. With 1 the FFTs are
+     * computed on the thread that reads the input. Must be called before
+     * start.
+     */
+    void workers(std::size_t count);
+    std::size_t workers() const;
+
+    /**
+     * Keeps both halves of the spectrum, which differ for complex input,
+     * instead of only the positive one. Must be called before start.
+     */
+    void two_sided(bool two_sided);
+    bool two_sided() const;
+
+    /**
+     * Scales the spectra as power spectral density per Hz at the given
+     * sample rate. A rate of 0 restores the default scaling. Must be
+     * called before start.
+     */
+    void psd(float rate);
+    float psd() const;
+
+    /**
+     * Returns the number of bins per lane for the newest config.
+     */
+    std::size_t bins() const;
+
+    /**
+     * Averages count consecutive spectra into each frame. alpha is the
+     * weight of the newest spectrum in exponential mode. Must be called
+     * before start.
+     */
+    void average(AverageMode mode, std::size_t count, float alpha = 0.25f);
+
+    /**
+     * Sets the number of frames that can be queued for the consumer.
+     * Must be called before start.
+     */
+    void queue_depth(std::size_t depth);
+    std::size_t queue_depth() const;
+
+    /**
+     * Returns the number of frames skipped because the stream was behind.
+     */
+    std::size_t frames_skipped() const;
+
+    /**
+     * Returns true if a frame is ready.
+     */
+    bool has_next();
+
+    /**
+     * Borrows the oldest frame. Only valid if has_next() returned true,
+     * and the frame stays valid until release is called.
+     */
+    const Frame& next();
+
+    /**
+     * Blocks until a frame is ready and borrows it, like next().
+     *
+     * Returns nullptr once the stream has ended and all of its frames
+     * have been borrowed, or if the FftSeq is being destroyed.
+     */
+    const Frame* wait_next();
+
+    /**
+     * Hands the borrowed frame back so that its buffer can be reused.
+     */
+    void release();
 };
 
 #endif /* WFALL_FFTSEQ_H */
@@ -0,0 +1,111 @@
+#include "format.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cctype>
+
+void parse_sample_format(const std::string& name, StreamFormat& format)
+{
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+            [](unsigned char c) { return std::tolower(c); });
+
+    std::string base = lower;
+    format.endian = std::endian::little;
+
+    if (lower.ends_with("le")) {
+        base = lower.substr(0, lower.size() - 2);
+    } else if (lower.ends_with("be")) {
+        base = lower.substr(0, lower.size() - 2);
+        format.endian = std::endian::big;
+    }
+
+    if (base.ends_with("_")) {
+        base.pop_back();
+    }
+
+    if (base == "u8") {
+        format.sample = SampleFormat::U8;
+    } else if (base == "s8") {
+        format.sample = SampleFormat::S8;
+    } else if (base == "s16") {
+        format.sample = SampleFormat::S16;
+    } else if (base == "s24_3") {
+        format.sample = SampleFormat::S24_3;
+    } else if (base == "s24") {
+        // ALSA's S24_LE is 24 bits in the low bytes of a 32 bit
+        // container, which is not supported, while s24_3 is packed.
+        throw std::invalid_argument("Ambiguous sample format: " + name
+                + ", use s24_3 for packed 3 byte samples");
+    } else if (base == "s32") {
+        format.sample = SampleFormat::S32;
+    } else if (base == "f32" || base == "float32") {
+        format.sample = SampleFormat::F32;
+    } else {
+        throw std::invalid_argument("Unknown sample format: " + name);
+    }
+}
+
+ChannelMode parse_channel_mode(const std::string& name)
+{
+    if (name == "mix") {
+        return ChannelMode::Mix;
+    } else if (name == "solo") {
+        return ChannelMode::Solo;
+    } else if (name == "iq") {
+        return ChannelMode::Iq;
+    } else if (name == "multi") {
+        return ChannelMode::Multi;
+    }
+
+    throw std::invalid_argument("Unknown channel mode: " + name);
+}
+
+template <typename Sample>
+static std::unique_ptr<Stream> make_stream(std::istream& input, const StreamFormat& format)
+{
+    auto stream = std::make_unique<PcmStream<Sample>>(input);
+    stream->channels(format.channels);
+    stream->endian(format.endian);
+
+    switch (format.mode) {
+        case ChannelMode::Mix:
+            stream->mix();
+            break;
+        case ChannelMode::Solo:
+            stream->solo(format.solo);
+            break;
+        case ChannelMode::Iq:
+            stream->iq();
+            break;
+        case ChannelMode::Multi:
+            stream->multi();
+            break;
+    }
+
+    return stream;
+}
+
+std::unique_ptr<Stream> make_pcm_stream(std::istream& input, const StreamFormat& format)
+{
+    if (format.channels == 0) {
+        throw std::invalid_argument("A stream needs at least one channel");
+    }
+
+    switch (format.sample) {
+        case SampleFormat::U8:
+            return make_stream<uint8_t>(input, format);
+        case SampleFormat::S8:
+            return make_stream<int8_t>(input, format);
+        case SampleFormat::S16:
+            return make_stream<int16_t>(input, format);
+        case SampleFormat::S24_3:
+            return make_stream<int24_3>(input, format);
+        case SampleFormat::S32:
+            return make_stream<int32_t>(input, format);
+        case SampleFormat::F32:
+            return make_stream<float>(input, format);
+    }
+
+    throw std::invalid_argument("Unknown sample format");
+}
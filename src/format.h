@@ -0,0 +1,68 @@
+#ifndef WFALL_FORMAT_H
+#define WFALL_FORMAT_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <bit>
+
+#include "fftseq.h"
+
+/**
+ * The sample formats that can be read from the input.
+ */
+enum class SampleFormat {
+    U8,
+    S8,
+    S16,
+    S24_3,
+    S32,
+    F32,
+};
+
+/**
+ * How the channels of a multichannel frame are combined.
+ *
+ * See PcmStream for a description of the modes.
+ */
+enum class ChannelMode {
+    Mix,
+    Solo,
+    Iq,
+    Multi,
+};
+
+/**
+ * Describes the layout of the PCM data on the input.
+ */
+struct StreamFormat {
+    SampleFormat sample = SampleFormat::S16;
+    std::endian endian = std::endian::little;
+    std::size_t channels = 2;
+    ChannelMode mode = ChannelMode::Mix;
+    std::size_t solo = 0;
+};
+
+/**
+ * Parses a sample format name such as "s16le", "s24_3le" or "u8".
+ *
+ * The names follow the ones used by parec and aplay. Throws
+ * std::invalid_argument for unknown names.
+ */
+void parse_sample_format(const std::string& name, StreamFormat& format);
+
+/**
+ * Parses a channel mode name ("mix", "iq", "solo" or "multi").
+ *
+ * Throws std::invalid_argument for unknown names.
+ */
+ChannelMode parse_channel_mode(const std::string& name);
+
+/**
+ * Builds a PcmStream for the given format reading from input.
+ *
+ * The returned stream holds a reference to input, which must outlive it.
+ */
+std::unique_ptr<Stream> make_pcm_stream(std::istream& input, const StreamFormat& format);
+
+#endif /* WFALL_FORMAT_H */
@@ -0,0 +1,70 @@
+#include "halfband.h"
+
+#include <stdexcept>
+
+HalfbandStream::HalfbandStream(Stream& source, std::size_t stages, std::size_t taps)
+    : _source(source)
+{
+    if (source.lanes() != 1) {
+        throw std::invalid_argument("HalfbandStream needs a single lane source");
+    }
+
+    for (std::size_t i = 0; i < stages; i++) {
+        _stages.emplace_back(taps);
+    }
+}
+
+std::size_t HalfbandStream::decimation() const
+{
+    return std::size_t(1) << _stages.size();
+}
+
+void HalfbandStream::read(OutSample* const* out, std::size_t count)
+{
+    std::size_t n = count * decimation();
+    _in.resize(n);
+
+    OutSample* ptr = _in.data();
+    _source.read(&ptr, n);
+
+    // Every stage halves the signal in place.
+    for (auto& stage : _stages) {
+        stage.process(_in.data(), n, _in.data());
+        n /= 2;
+    }
+
+    std::copy_n(_in.data(), count, out[0]);
+}
+
+void HalfbandStream::skip(std::size_t count)
+{
+    // The input span that still affects later outputs, rounded up to
+    // whole outputs.
+    std::size_t history = 0;
+    for (std::size_t i = 0; i < _stages.size(); i++) {
+        history += _stages[i].taps() << i;
+    }
+    std::size_t tail = std::min(count, (history + decimation() - 1) / decimation());
+
+    // The tail is run through the filters and thrown away. It goes to a
+    // buffer of its own, since read() resizes _in.
+    _source.skip((count - tail) * decimation());
+    _discard.resize(tail);
+    OutSample* ptr = _discard.data();
+    read(&ptr, tail);
+}
+
+Stream::Clock::time_point HalfbandStream::arrival() const
+{
+    return _source.arrival();
+}
+
+bool HalfbandStream::eof() const
+{
+    return _source.eof();
+}
+
+bool HalfbandStream::behind() const
+{
+    return _source.behind();
+}
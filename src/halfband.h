@@ -0,0 +1,42 @@
+#ifndef WFALL_HALFBAND_H
+#define WFALL_HALFBAND_H
+
+#include "fftseq.h"
+#include "dsp.h"
+
+/**
+ * A cascade of half-band decimators.
+ *
+ * Wraps a Stream and reduces its sample rate by 2^stages, keeping the
+ * lower part of the band. When only the low band of a high rate signal
+ * is of interest, the FFT size needed for a given resolution drops by
+ * the same factor.
+ */
+class HalfbandStream : public Stream {
+    Stream& _source;
+    std::vector<HalfbandDecimator> _stages;
+    std::vector<OutSample> _in;
+    std::vector<OutSample> _discard;
+
+public:
+    /**
+     * ctor.
+     *
+     * Each stage uses a half-band filter with the given number of taps,
+     * which must be of the form 4m + 3.
+     */
+    HalfbandStream(Stream& source, std::size_t stages, std::size_t taps = 23);
+
+    /**
+     * Returns the total decimation, 2^stages.
+     */
+    std::size_t decimation() const;
+
+    void read(OutSample* const* out, std::size_t count) override;
+    void skip(std::size_t count) override;
+    Clock::time_point arrival() const override;
+    bool eof() const override;
+    bool behind() const override;
+};
+
+#endif /* WFALL_HALFBAND_H */
@@ -0,0 +1,85 @@
+#include "history.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+SampleHistory::SampleHistory(std::size_t capacity, std::size_t max_frame, std::size_t lanes)
+    : _capacity(std::bit_ceil(capacity)), _max_frame(max_frame), _lanes(lanes),
+      _stride(_capacity + max_frame), _data(_lanes * _stride)
+{
+    if (capacity == 0 || lanes == 0 || max_frame > _capacity) {
+        throw std::invalid_argument("A SampleHistory must hold at least one frame");
+    }
+}
+
+std::size_t SampleHistory::capacity() const
+{
+    return _capacity;
+}
+
+std::size_t SampleHistory::max_frame() const
+{
+    return _max_frame;
+}
+
+std::size_t SampleHistory::lanes() const
+{
+    return _lanes;
+}
+
+uint64_t SampleHistory::written() const
+{
+    return _written;
+}
+
+std::complex<float>* SampleHistory::write_ptr(std::size_t lane)
+{
+    return _data.data() + lane * _stride + (_written & (_capacity - 1));
+}
+
+std::size_t SampleHistory::write_contiguous() const
+{
+    return _capacity - (_written & (_capacity - 1));
+}
+
+void SampleHistory::commit(std::size_t count)
+{
+    // Only the start of each lane is mirrored.
+    std::size_t pos = _written & (_capacity - 1);
+    if (pos < _max_frame) {
+        std::size_t n = std::min(count, _max_frame - pos);
+        for (std::size_t l = 0; l < _lanes; l++) {
+            auto lane = _data.begin() + l * _stride;
+            std::copy_n(lane + pos, n, lane + _capacity + pos);
+        }
+    }
+
+    _written += count;
+}
+
+void SampleHistory::skip(uint64_t count)
+{
+    _written += count;
+}
+
+const std::complex<float>* SampleHistory::frame(std::size_t lane, uint64_t start) const
+{
+    return _data.data() + lane * _stride + (start & (_capacity - 1));
+}
+
+void SampleHistory::append(const SampleHistory& from, std::size_t count)
+{
+    uint64_t start = from._written - count;
+    while (count > 0) {
+        // From start on, from is contiguous up to the end of its mirror.
+        std::size_t pos = start & (from._capacity - 1);
+        std::size_t n = std::min({count, write_contiguous(), from._stride - pos});
+        for (std::size_t l = 0; l < _lanes; l++) {
+            std::copy_n(from.frame(l, start), n, write_ptr(l));
+        }
+        commit(n);
+        start += n;
+        count -= n;
+    }
+}
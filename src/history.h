@@ -0,0 +1,87 @@
+#ifndef WFALL_HISTORY_H
+#define WFALL_HISTORY_H
+
+#include <vector>
+#include <complex>
+#include <cstdint>
+
+/**
+ * A circular history of the most recent samples of a stream.
+ *
+ * The first max_frame() samples of every lane are mirrored past its end,
+ * so that any max_frame() consecutive samples that are still in the
+ * history can be read in place as one contiguous array. Overlapping
+ * frames then only cost writing the new samples once (twice for the few
+ * that fall in the mirrored region), instead of moving the retained
+ * samples on every hop.
+ *
+ * Positions are counted in samples written since construction. The
+ * samples before position 0 read as zeros.
+ */
+class SampleHistory {
+    std::size_t _capacity;
+    std::size_t _max_frame;
+    std::size_t _lanes;
+    std::size_t _stride;
+    std::vector<std::complex<float>> _data;
+    uint64_t _written = 0;
+
+public:
+    /**
+     * ctor.
+     *
+     * Holds the last capacity samples of each lane, rounded up to a power
+     * of two, and supports frames of up to max_frame samples, which must
+     * not be more than the capacity.
+     */
+    SampleHistory(std::size_t capacity, std::size_t max_frame, std::size_t lanes = 1);
+
+    std::size_t capacity() const;
+    std::size_t max_frame() const;
+    std::size_t lanes() const;
+
+    /**
+     * Returns the number of samples written per lane since construction.
+     */
+    uint64_t written() const;
+
+    /**
+     * Returns a pointer to the next position of lane.
+     */
+    std::complex<float>* write_ptr(std::size_t lane);
+
+    /**
+     * Returns the number of samples that can be written contiguously at
+     * write_ptr().
+     */
+    std::size_t write_contiguous() const;
+
+    /**
+     * Publishes count samples written at write_ptr() in every lane.
+     * count must not be more than write_contiguous().
+     */
+    void commit(std::size_t count);
+
+    /**
+     * Moves the position on by count samples without writing them. The
+     * skipped samples must not be read.
+     */
+    void skip(uint64_t count);
+
+    /**
+     * Returns a pointer to the samples of lane from position start on.
+     *
+     * At least max_frame() samples can be read, but only those that have
+     * not been overwritten yet, that is those after written() -
+     * capacity(), are valid.
+     */
+    const std::complex<float>* frame(std::size_t lane, uint64_t start) const;
+
+    /**
+     * Writes the newest count samples of from, which must have the same
+     * number of lanes and still hold them.
+     */
+    void append(const SampleHistory& from, std::size_t count);
+};
+
+#endif /* WFALL_HISTORY_H */
@@ -0,0 +1,333 @@
+#include "net.h"
+
+#include <cerrno>
+#include <cstring>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+/** Receive buffer requested from the kernel, it may grant less. */
+static const int SOCKET_BUFFER = 16 << 20;
+
+/** Largest sequence gap that is filled in, in datagrams. */
+static const int32_t MAX_GAP = 1 << 12;
+
+static std::runtime_error socket_error(const std::string& what)
+{
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+/**
+ * Splits "host:port" into its parts. The host may be empty, and IPv6
+ * hosts may be given in brackets.
+ */
+static void split_address(const std::string& address, std::string& host, std::string& port)
+{
+    std::size_t colon = address.rfind(':');
+    if (colon == std::string::npos) {
+        host.clear();
+        port = address;
+    } else {
+        host = address.substr(0, colon);
+        port = address.substr(colon + 1);
+    }
+
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+
+    if (port.empty()) {
+        throw std::invalid_argument("Missing port in " + address);
+    }
+}
+
+/**
+ * Creates a socket of the given type that is connected or bound to
+ * address.
+ */
+static int open_socket(const std::string& address, int type, bool bind_socket)
+{
+    std::string host;
+    std::string port;
+    split_address(address, host, port);
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = type;
+    hints.ai_flags = bind_socket ? AI_PASSIVE : 0;
+
+    addrinfo* result;
+    int err = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result);
+    if (err != 0) {
+        throw std::runtime_error("Could not resolve " + address + ": " + gai_strerror(err));
+    }
+
+    int fd = -1;
+    int saved = 0;
+    for (addrinfo* ai = result; ai != nullptr; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            saved = errno;
+            continue;
+        }
+
+        // Set before connecting, so that the TCP window is scaled to
+        // match.
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &SOCKET_BUFFER, sizeof(SOCKET_BUFFER));
+
+        int ret = bind_socket ? bind(fd, ai->ai_addr, ai->ai_addrlen) : connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (ret == 0) {
+            break;
+        }
+
+        saved = errno;
+        close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(result);
+
+    if (fd < 0) {
+        errno = saved;
+        throw socket_error(std::string(bind_socket ? "Could not bind " : "Could not connect to ") + address);
+    }
+
+    return fd;
+}
+
+RtlTcpBuf::RtlTcpBuf(const std::string& address, std::size_t chunk)
+    : _buffer(chunk)
+{
+    _fd = open_socket(address, SOCK_STREAM, false);
+
+    // Commands are tiny and should not wait for more data.
+    int one = 1;
+    setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    unsigned char header[12];
+    std::size_t got = 0;
+    while (got < sizeof(header)) {
+        ssize_t n = recv(_fd, header + got, sizeof(header) - got, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            close(_fd);
+            throw std::runtime_error("Connection to " + address + " closed before the header");
+        }
+        got += n;
+    }
+
+    if (std::memcmp(header, "RTL0", 4) != 0) {
+        close(_fd);
+        throw std::runtime_error(address + " is not an rtl_tcp server");
+    }
+
+    auto be32 = [](const unsigned char* p) {
+        return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]);
+    };
+    _tuner = be32(header + 4);
+    _gains = be32(header + 8);
+}
+
+RtlTcpBuf::~RtlTcpBuf()
+{
+    close(_fd);
+}
+
+void RtlTcpBuf::command(RtlCommand cmd, uint32_t param)
+{
+    unsigned char msg[5] = {
+        static_cast<unsigned char>(cmd),
+        static_cast<unsigned char>(param >> 24),
+        static_cast<unsigned char>(param >> 16),
+        static_cast<unsigned char>(param >> 8),
+        static_cast<unsigned char>(param),
+    };
+
+    std::size_t sent = 0;
+    while (sent < sizeof(msg)) {
+        ssize_t n = send(_fd, msg + sent, sizeof(msg) - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            throw socket_error("Could not send rtl_tcp command");
+        }
+        sent += n;
+    }
+}
+
+void RtlTcpBuf::gain(std::optional<float> gain)
+{
+    if (gain) {
+        command(RtlCommand::GainMode, 1);
+        command(RtlCommand::Gain, static_cast<uint32_t>(std::lround(*gain * 10.0f)));
+    } else {
+        command(RtlCommand::GainMode, 0);
+    }
+}
+
+uint32_t RtlTcpBuf::tuner() const
+{
+    return _tuner;
+}
+
+uint32_t RtlTcpBuf::gain_count() const
+{
+    return _gains;
+}
+
+RtlTcpBuf::int_type RtlTcpBuf::underflow()
+{
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    ssize_t n;
+    do {
+        n = recv(_fd, _buffer.data(), _buffer.size(), 0);
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0) {
+        return traits_type::eof();
+    }
+
+    setg(_buffer.data(), _buffer.data(), _buffer.data() + n);
+
+    return traits_type::to_int_type(*gptr());
+}
+
+UdpBuf::UdpBuf(const std::string& address, bool sequenced, std::size_t batch, std::size_t max_size)
+    : _max_size(max_size), _sequenced(sequenced), _memory(batch * max_size),
+      _msgs(batch), _iovecs(batch), _zeros(max_size)
+{
+    if (batch == 0 || max_size <= (sequenced ? 4 : 0)) {
+        throw std::invalid_argument("UdpBuf needs room for at least one datagram");
+    }
+
+    _fd = open_socket(address, SOCK_DGRAM, true);
+
+    for (std::size_t i = 0; i < batch; i++) {
+        _iovecs[i].iov_base = _memory.data() + i * max_size;
+        _iovecs[i].iov_len = max_size;
+        std::memset(&_msgs[i], 0, sizeof(_msgs[i]));
+        _msgs[i].msg_hdr.msg_iov = &_iovecs[i];
+        _msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+UdpBuf::~UdpBuf()
+{
+    close(_fd);
+}
+
+UdpStats UdpBuf::stats() const
+{
+    UdpStats stats;
+    stats.datagrams = _datagrams.load(std::memory_order_relaxed);
+    stats.lost = _lost.load(std::memory_order_relaxed);
+    stats.late = _late.load(std::memory_order_relaxed);
+    stats.truncated = _truncated.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+bool UdpBuf::receive()
+{
+    // Block for the first datagram, then take whatever else is queued.
+    int n;
+    do {
+        n = recvmmsg(_fd, _msgs.data(), _msgs.size(), MSG_WAITFORONE, nullptr);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+        return false;
+    }
+
+    _received = n;
+    _next = 0;
+    _datagrams.fetch_add(n, std::memory_order_relaxed);
+
+    return true;
+}
+
+UdpBuf::int_type UdpBuf::underflow()
+{
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    while (1) {
+        if (_fill > 0) {
+            std::size_t n = std::min(_fill, _zeros.size());
+            _fill -= n;
+            setg(_zeros.data(), _zeros.data(), _zeros.data() + n);
+            return traits_type::to_int_type(*gptr());
+        }
+
+        if (_held) {
+            setg(_held, _held, _held + _held_size);
+            _held = nullptr;
+            return traits_type::to_int_type(*gptr());
+        }
+
+        if (_next == _received && !receive()) {
+            return traits_type::eof();
+        }
+
+        const mmsghdr& msg = _msgs[_next];
+        char* data = static_cast<char*>(_iovecs[_next].iov_base);
+        std::size_t size = msg.msg_len;
+        _next++;
+
+        if (msg.msg_hdr.msg_flags & MSG_TRUNC) {
+            _truncated.fetch_add(1, std::memory_order_relaxed);
+            size = _max_size;
+        }
+
+        if (_sequenced) {
+            if (size < 4) {
+                continue;
+            }
+
+            uint32_t seq = uint32_t(uint8_t(data[0])) | uint32_t(uint8_t(data[1])) << 8
+                | uint32_t(uint8_t(data[2])) << 16 | uint32_t(uint8_t(data[3])) << 24;
+            data += 4;
+            size -= 4;
+
+            if (_expected) {
+                // Wrapping difference, negative means late. A jump larger
+                // than MAX_GAP is taken to be a restarted sender.
+                int32_t gap = static_cast<int32_t>(seq - *_expected);
+                if (gap < 0 && gap > -MAX_GAP) {
+                    _late.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+
+                if (gap > 0 && gap < MAX_GAP) {
+                    _lost.fetch_add(gap, std::memory_order_relaxed);
+                    _fill = gap * _payload;
+                }
+            }
+
+            _expected = seq + 1;
+            _payload = size;
+        }
+
+        // The zeros for lost datagrams go first.
+        _held = data;
+        _held_size = size;
+        if (size == 0) {
+            _held = nullptr;
+        }
+    }
+}
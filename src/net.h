@@ -0,0 +1,156 @@
+#ifndef WFALL_NET_H
+#define WFALL_NET_H
+
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <optional>
+#include <cstdint>
+
+struct mmsghdr;
+struct iovec;
+
+/**
+ * Commands understood by rtl_tcp, sent as one byte followed by a big
+ * endian 32 bit parameter.
+ */
+enum class RtlCommand : uint8_t {
+    Frequency = 0x01,
+    SampleRate = 0x02,
+    GainMode = 0x03,
+    Gain = 0x04,
+    FreqCorrection = 0x05,
+    AgcMode = 0x08,
+};
+
+/**
+ * A stream buffer reading samples from an rtl_tcp server.
+ *
+ * The server starts with a 12 byte header ("RTL0", the tuner type and
+ * the number of gain steps) and then streams interleaved unsigned 8 bit
+ * IQ samples. Use it as the buffer of an std::istream to feed a
+ * PcmStream.
+ */
+class RtlTcpBuf : public std::streambuf {
+    int _fd = -1;
+    std::vector<char> _buffer;
+    uint32_t _tuner = 0;
+    uint32_t _gains = 0;
+
+protected:
+    int_type underflow() override;
+
+public:
+    /**
+     * ctor.
+     *
+     * Connects to address, given as "host:port", and reads the header.
+     * Throws std::runtime_error if the connection fails or the server
+     * does not speak rtl_tcp.
+     */
+    RtlTcpBuf(const std::string& address, std::size_t chunk = 1 << 16);
+    ~RtlTcpBuf();
+
+    RtlTcpBuf(const RtlTcpBuf&) = delete;
+    RtlTcpBuf& operator=(const RtlTcpBuf&) = delete;
+
+    /**
+     * Sends a command to the server.
+     */
+    void command(RtlCommand cmd, uint32_t param);
+
+    /**
+     * Sets a manual gain in dB, or automatic gain if gain is empty.
+     */
+    void gain(std::optional<float> gain);
+
+    /**
+     * Returns the tuner type reported by the server.
+     */
+    uint32_t tuner() const;
+
+    /**
+     * Returns the number of gain steps reported by the server.
+     */
+    uint32_t gain_count() const;
+};
+
+/**
+ * Packet loss on a UdpBuf.
+ */
+struct UdpStats {
+    /** Datagrams received. */
+    std::size_t datagrams = 0;
+    /** Datagrams missing from the sequence. */
+    std::size_t lost = 0;
+    /** Datagrams that arrived late or twice and were dropped. */
+    std::size_t late = 0;
+    /** Datagrams that did not fit the receive buffer. */
+    std::size_t truncated = 0;
+};
+
+/**
+ * A stream buffer reading raw sample datagrams from a UDP socket.
+ *
+ * Datagrams are received in batches with recvmmsg. If the datagrams are
+ * sequenced, each starts with a little endian 32 bit counter that is
+ * stripped from the payload. Missing datagrams are replaced with zeros
+ * of the same length, so that the time base of the stream is kept, and
+ * late or duplicate datagrams are dropped. Large jumps in the sequence
+ * are taken as a restart of the sender and are not filled in.
+ *
+ * The payload of every datagram must be a whole number of frames.
+ */
+class UdpBuf : public std::streambuf {
+    int _fd = -1;
+    std::size_t _max_size;
+    bool _sequenced;
+
+    std::vector<char> _memory;
+    std::vector<mmsghdr> _msgs;
+    std::vector<iovec> _iovecs;
+    std::size_t _received = 0;
+    std::size_t _next = 0;
+
+    std::optional<uint32_t> _expected;
+    std::size_t _payload = 0;
+    /** Bytes of zeros still to be returned for lost datagrams. */
+    std::size_t _fill = 0;
+    /** A datagram waiting behind the zeros. */
+    char* _held = nullptr;
+    std::size_t _held_size = 0;
+    std::vector<char> _zeros;
+
+    std::atomic<std::size_t> _datagrams = 0;
+    std::atomic<std::size_t> _lost = 0;
+    std::atomic<std::size_t> _late = 0;
+    std::atomic<std::size_t> _truncated = 0;
+
+    bool receive();
+
+protected:
+    int_type underflow() override;
+
+public:
+    /**
+     * ctor.
+     *
+     * Binds to address, given as "[host:]port". Up to batch datagrams of
+     * at most max_size bytes are received per system call. Throws
+     * std::runtime_error if the socket can not be bound.
+     */
+    UdpBuf(const std::string& address, bool sequenced,
+            std::size_t batch = 64, std::size_t max_size = 65536);
+    ~UdpBuf();
+
+    UdpBuf(const UdpBuf&) = delete;
+    UdpBuf& operator=(const UdpBuf&) = delete;
+
+    /**
+     * Returns the loss statistics so far. Safe to call from any thread.
+     */
+    UdpStats stats() const;
+};
+
+#endif /* WFALL_NET_H */
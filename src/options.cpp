@@ -0,0 +1,389 @@
+#include "options.h"
+
+#include <stdexcept>
+#include <bit>
+#include <cstdint>
+
+static std::string next_arg(int argc, char** argv, int& i)
+{
+    std::string opt = argv[i];
+    if (++i >= argc) {
+        throw std::invalid_argument("Missing value for " + opt);
+    }
+
+    return argv[i];
+}
+
+static std::size_t parse_size(const std::string& opt, const std::string& value)
+{
+    try {
+        std::size_t pos;
+        unsigned long long n = std::stoull(value, &pos);
+        if (pos == value.size() && value[0] != '-') {
+            return n;
+        }
+    } catch (const std::logic_error&) {}
+
+    throw std::invalid_argument("Invalid value for " + opt + ": " + value);
+}
+
+static float parse_float(const std::string& opt, const std::string& value)
+{
+    try {
+        std::size_t pos;
+        float x = std::stof(value, &pos);
+        if (pos == value.size()) {
+            return x;
+        }
+    } catch (const std::logic_error&) {}
+
+    throw std::invalid_argument("Invalid value for " + opt + ": " + value);
+}
+
+static std::pair<float, float> parse_range(const std::string& opt, const std::string& value)
+{
+    std::size_t sep = value.find(':', 1);
+    if (sep == std::string::npos) {
+        throw std::invalid_argument("Invalid value for " + opt + ": " + value);
+    }
+
+    float lo = parse_float(opt, value.substr(0, sep));
+    float hi = parse_float(opt, value.substr(sep + 1));
+    if (lo >= hi) {
+        throw std::invalid_argument("Invalid value for " + opt + ": " + value);
+    }
+
+    return {lo, hi};
+}
+
+/**
+ * Parses SIZE[:RATE[:WINDOW]], taking the missing values from opts.
+ */
+static ViewOptions parse_view(const std::string& opt, const std::string& value, const Options& opts)
+{
+    ViewOptions view{opts.fft_size, opts.fft_rate, opts.window};
+
+    std::size_t sep = value.find(':');
+    view.fft_size = parse_size(opt, value.substr(0, sep));
+    if (sep != std::string::npos) {
+        std::size_t sep2 = value.find(':', sep + 1);
+        view.fft_rate = parse_float(opt, value.substr(sep + 1, sep2 - sep - 1));
+        if (sep2 != std::string::npos) {
+            view.window = parse_window(value.substr(sep2 + 1));
+        }
+    }
+
+    if (view.fft_size < 2 || !std::has_single_bit(view.fft_size) || view.fft_rate <= 0.0f) {
+        throw std::invalid_argument("Invalid value for " + opt + ": " + value);
+    }
+
+    return view;
+}
+
+Options parse_options(int argc, char** argv)
+{
+    Options opts;
+    std::vector<std::string> views;
+
+    for (int i = 1; i < argc; i++) {
+        std::string opt = argv[i];
+
+        if (opt == "-h" || opt == "--help") {
+            opts.help = true;
+        } else if (opt == "--latency") {
+            opts.latency = true;
+        } else if (opt == "--stage-threads") {
+            opts.stage_threads = true;
+        } else if (opt == "-i" || opt == "--input") {
+            opts.input = next_arg(argc, argv, i);
+        } else if (opt == "-o" || opt == "--output") {
+            opts.output = next_arg(argc, argv, i);
+        } else if (opt == "--rtl-tcp") {
+            opts.rtl_tcp = next_arg(argc, argv, i);
+        } else if (opt == "--rtl-freq") {
+            opts.rtl_freq = parse_size(opt, next_arg(argc, argv, i));
+        } else if (opt == "--rtl-gain") {
+            opts.rtl_gain = parse_float(opt, next_arg(argc, argv, i));
+        } else if (opt == "--udp") {
+            opts.udp = next_arg(argc, argv, i);
+        } else if (opt == "--udp-seq") {
+            opts.udp_seq = true;
+        } else if (opt == "-f" || opt == "--format") {
+            parse_sample_format(next_arg(argc, argv, i), opts.format);
+        } else if (opt == "-c" || opt == "--channels") {
+            opts.format.channels = parse_size(opt, next_arg(argc, argv, i));
+        } else if (opt == "-m" || opt == "--mode") {
+            opts.format.mode = parse_channel_mode(next_arg(argc, argv, i));
+        } else if (opt == "--solo") {
+            opts.format.solo = parse_size(opt, next_arg(argc, argv, i));
+            opts.format.mode = ChannelMode::Solo;
+        } else if (opt == "-r" || opt == "--rate") {
+            opts.rate = parse_float(opt, next_arg(argc, argv, i));
+        } else if (opt == "--buffer") {
+            opts.buffer = parse_float(opt, next_arg(argc, argv, i));
+        } else if (opt == "--drop") {
+            opts.drop = parse_drop_policy(next_arg(argc, argv, i));
+        } else if (opt == "--uring") {
+            opts.uring = true;
+        } else if (opt == "--uring-depth") {
+            opts.uring_depth = parse_size(opt, next_arg(argc, argv, i));
+            opts.uring = true;
+        } else if (opt == "--fir") {
+            opts.fir = next_arg(argc, argv, i);
+        } else if (opt == "--fir-block") {
+            opts.fir_block = parse_size(opt, next_arg(argc, argv, i));
+        } else if (opt == "--ddc") {
+            opts.ddc = parse_float(opt, next_arg(argc, argv, i));
+        } else if (opt == "--ddc-decim") {
+            opts.ddc_decim = parse_size(opt, next_arg(argc, argv, i));
+        } else if (opt == "--halfband") {
+            opts.halfband = parse_size(opt, next_arg(argc, argv, i));
+        } else if (opt == "--resample") {
+            opts.resample = parse_float(opt, next_arg(argc, argv, i));
+        } else if (opt == "--fft-rate") {
+            opts.fft_rate = parse_float(opt, next_arg(argc, argv, i));
+        } else if (opt == "-n" || opt == "--fft-size") {
+            opts.fft_size = parse_size(opt, next_arg(argc, argv, i));
+        } else if (opt == "--pfb") {
+            opts.pfb_taps = parse_size(opt, next_arg(argc, argv, i));
+        } else if (opt == "-w" || opt == "--window") {
+            opts.window = parse_window(next_arg(argc, argv, i));
+        } else if (opt == "--average") {
+            opts.average = parse_average_mode(next_arg(argc, argv, i));
+        } else if (opt == "--average-count") {
+            opts.average_count = parse_size(opt, next_arg(argc, argv, i));
+        } else if (opt == "--alpha") {
+            opts.alpha = parse_float(opt, next_arg(argc, argv, i));
+        } else if (opt == "--psd") {
+            opts.psd = true;
+        } else if (opt == "--welch") {
+            opts.welch = parse_size(opt, next_arg(argc, argv, i));
+            opts.psd = true;
+        } else if (opt == "--cqt") {
+            std::string value = next_arg(argc, argv, i);
+            std::size_t sep = value.find(':');
+            opts.cqt_freq = parse_float(opt, value.substr(0, sep));
+            if (sep != std::string::npos) {
+                opts.cqt_bins_per_octave = parse_size(opt, value.substr(sep + 1));
+            }
+        } else if (opt == "--axis") {
+            opts.axis = parse_axis(next_arg(argc, argv, i));
+        } else if (opt == "--db-range") {
+            opts.db_range = parse_range(opt, next_arg(argc, argv, i));
+        } else if (opt == "--fft-threads") {
+            opts.fft_threads = parse_size(opt, next_arg(argc, argv, i));
+        } else if (opt == "--view") {
+            views.push_back(next_arg(argc, argv, i));
+        } else {
+            throw std::invalid_argument("Unknown option: " + opt);
+        }
+    }
+
+    for (const std::string& view : views) {
+        opts.views.push_back(parse_view("--view", view, opts));
+    }
+
+    if (!opts.input.empty() + !opts.rtl_tcp.empty() + !opts.udp.empty() > 1) {
+        throw std::invalid_argument("Only one of --input, --rtl-tcp and --udp can be given");
+    }
+
+    if (opts.uring && (!opts.rtl_tcp.empty() || !opts.udp.empty())) {
+        throw std::invalid_argument("--uring can only read files and stdin");
+    }
+
+    if (!opts.output.empty()) {
+        if (!opts.rtl_tcp.empty() || !opts.udp.empty()) {
+            throw std::invalid_argument("--output can only read files and stdin");
+        }
+        if (!opts.views.empty()) {
+            throw std::invalid_argument("--output writes a single view");
+        }
+    }
+
+    if (!opts.rtl_tcp.empty()) {
+        // rtl_tcp always sends unsigned 8 bit IQ.
+        opts.format.sample = SampleFormat::U8;
+        opts.format.channels = 2;
+        if (opts.format.mode != ChannelMode::Multi) {
+            opts.format.mode = ChannelMode::Iq;
+        }
+    }
+
+    if (opts.rtl_freq && *opts.rtl_freq > UINT32_MAX) {
+        throw std::invalid_argument("The tuner frequency is out of range");
+    }
+
+    if (opts.format.channels == 0) {
+        throw std::invalid_argument("The number of channels must be at least 1");
+    }
+
+    if (opts.average_count == 0) {
+        throw std::invalid_argument("At least one FFT must be averaged");
+    }
+
+    if (opts.alpha <= 0.0f || opts.alpha > 1.0f) {
+        throw std::invalid_argument("The averaging weight must be in (0, 1]");
+    }
+
+    if (opts.welch && opts.average != AverageMode::None) {
+        throw std::invalid_argument("--welch averages linearly and can not be combined with --average");
+    }
+
+    if (opts.fft_threads && *opts.fft_threads == 0) {
+        throw std::invalid_argument("At least one FFT thread is needed");
+    }
+
+    if (opts.pfb_taps == 0) {
+        throw std::invalid_argument("The filter bank needs at least one tap");
+    }
+
+    if (opts.fft_size < 2 || !std::has_single_bit(opts.fft_size)) {
+        throw std::invalid_argument("The FFT size must be a power of two");
+    }
+
+    if (opts.rate <= 0.0f || opts.fft_rate <= 0.0f) {
+        throw std::invalid_argument("Rates must be positive");
+    }
+
+    if (opts.cqt_freq) {
+        if (*opts.cqt_freq <= 0.0f || opts.cqt_bins_per_octave == 0) {
+            throw std::invalid_argument("Invalid value for --cqt");
+        }
+        if (opts.format.mode == ChannelMode::Iq || opts.ddc) {
+            throw std::invalid_argument("--cqt needs real input");
+        }
+        if (opts.pfb_taps > 1) {
+            throw std::invalid_argument("--cqt can not be combined with --pfb");
+        }
+        if (opts.axis) {
+            throw std::invalid_argument("--cqt can not be combined with --axis");
+        }
+    }
+
+    if (opts.axis && opts.axis->scale != FreqScale::Linear
+            && (opts.format.mode == ChannelMode::Iq || opts.ddc)) {
+        throw std::invalid_argument("Only a linear --axis can show complex input");
+    }
+
+    if (!std::has_single_bit(opts.fir_block)) {
+        throw std::invalid_argument("The FIR block size must be a power of two");
+    }
+
+    if (opts.ddc_decim == 0) {
+        throw std::invalid_argument("The decimation must be at least 1");
+    }
+
+    if (opts.halfband > 16) {
+        throw std::invalid_argument("At most 16 half-band stages are supported");
+    }
+
+    if (opts.resample && *opts.resample <= 0.0f) {
+        throw std::invalid_argument("The resampling rate must be positive");
+    }
+
+    if (opts.uring_depth == 0 || opts.uring_depth > 64) {
+        throw std::invalid_argument("The io_uring depth must be between 1 and 64");
+    }
+
+    if (opts.buffer <= 0.0f) {
+        throw std::invalid_argument("The buffer length must be positive");
+    }
+
+    return opts;
+}
+
+void print_usage(std::ostream& out, const char* name)
+{
+    out << "Usage: " << name << " [options] [-i FILE | --rtl-tcp HOST:PORT | --udp PORT | < input]\n"
+        << "\n"
+        << "Input options:\n"
+        << "  -i, --input FILE     read from FILE instead of stdin\n"
+        << "      --rtl-tcp HOST:PORT\n"
+        << "                       read IQ samples from an rtl_tcp server, implies\n"
+        << "                       --format u8 --channels 2 --mode iq; the sample\n"
+        << "                       rate is set to --rate\n"
+        << "      --rtl-freq HZ    tune the rtl_tcp server to HZ\n"
+        << "      --rtl-gain DB    tuner gain of the rtl_tcp server (default auto)\n"
+        << "      --udp [HOST:]PORT\n"
+        << "                       receive raw sample datagrams on PORT\n"
+        << "      --udp-seq        datagrams start with a little endian 32 bit\n"
+        << "                       sequence number; lost ones are filled with zeros\n"
+        << "  -f, --format FMT     sample format: u8, s8, s16le, s16be, s24_3le,\n"
+        << "                       s24_3be, s32le, s32be, f32le, f32be (default s16le)\n"
+        << "  -c, --channels N     number of interleaved channels (default 2)\n"
+        << "  -m, --mode MODE      how to combine channels: mix, solo, iq, or multi\n"
+        << "                       to show every channel separately (default mix)\n"
+        << "      --solo N         show only channel N\n"
+        << "  -r, --rate HZ        sample rate (default 44100)\n"
+        << "      --buffer SEC     length of the input buffer in seconds (default 1)\n"
+        << "      --drop POLICY    what to do when processing falls behind: block,\n"
+        << "                       oldest (drop the backlog) or decimate (skip\n"
+        << "                       frames) (default block)\n"
+        << "      --uring          read the input with io_uring\n"
+        << "      --uring-depth N  number of io_uring reads in flight, implies\n"
+        << "                       --uring (default 4)\n"
+        << "\n"
+        << "Processing options:\n"
+        << "      --fir FILE       filter the input with the FIR taps in FILE\n"
+        << "      --fir-block N    block size of the FIR convolution, a power of\n"
+        << "                       two; it is also the latency (default 1024)\n"
+        << "      --ddc HZ         zoom in on the band around HZ with a digital\n"
+        << "                       down-converter\n"
+        << "      --ddc-decim N    decimation of the down-converter (default 8)\n"
+        << "      --halfband K     keep the low band by decimating by 2^K with a\n"
+        << "                       cascade of half-band filters\n"
+        << "      --resample HZ    resample to HZ, for example to line up the bins\n"
+        << "                       of sources with different rates\n"
+        << "      --stage-threads  run the input and every processing stage on a\n"
+        << "                       thread of its own and print their throughput\n"
+        << "\n"
+        << "FFT options:\n"
+        << "  -n, --fft-size N     FFT size, a power of two (default 4096)\n"
+        << "      --fft-rate HZ    FFTs per second (default 12)\n"
+        << "      --pfb TAPS       use a polyphase filter bank with TAPS taps per\n"
+        << "                       bin instead of a plain window (default 1, off)\n"
+        << "  -w, --window NAME    window function: rectangular, hann, hamming,\n"
+        << "                       blackman, blackman-harris, nuttall, flattop,\n"
+        << "                       kaiser[:BETA] or dpss[:NW] (default blackman)\n"
+        << "      --average MODE   combine consecutive spectra: none, linear (mean\n"
+        << "                       power), exp (exponential average), max or min\n"
+        << "                       (default none)\n"
+        << "      --average-count N\n"
+        << "                       spectra per displayed row when averaging; rows\n"
+        << "                       are shown at the FFT rate / N (default 4)\n"
+        << "      --alpha A        weight of the newest spectrum in exp mode\n"
+        << "                       (default 0.25)\n"
+        << "      --psd            show power spectral density in dBFS/Hz\n"
+        << "      --welch K        Welch estimate of the power spectral density:\n"
+        << "                       each row averages K segments that overlap by\n"
+        << "                       half; overrides --fft-rate\n"
+        << "      --cqt FMIN[:BPO] show a constant-Q transform with BPO bins per\n"
+        << "                       octave (default 24) from FMIN Hz up, instead of\n"
+        << "                       linear bins; raises the FFT size to fit FMIN\n"
+        << "      --axis SCALE[:F1,F2,...]\n"
+        << "                       rebin the spectra to one bin per pixel on a\n"
+        << "                       linear, log, mel or bark frequency axis, from F1\n"
+        << "                       to the last frequency in Hz with equal room for\n"
+        << "                       every interval (default: all of the spectrum, or\n"
+        << "                       three decades on the log axis)\n"
+        << "      --db-range LO:HI range of the display in dB (default -100:-20,\n"
+        << "                       shifted by the bin bandwidth with --psd)\n"
+        << "      --fft-threads N  compute FFTs on N threads, for high FFT rates\n"
+        << "                       (default 1, or one per core with --output)\n"
+        << "      --view SIZE[:RATE[:WINDOW]]\n"
+        << "                       add a panel with another FFT size, rate and\n"
+        << "                       window of the same input; can be repeated\n"
+        << "\n"
+        << "  -o, --output FILE    write the spectrogram of the whole input to FILE\n"
+        << "                       instead of showing it, as rows of float32 dB\n"
+        << "                       values, raw or NPY if FILE ends in .npy; \"-\"\n"
+        << "                       writes raw values to stdout\n"
+        << "      --latency        print the latency of the displayed frames\n"
+        << "  -h, --help           show this message\n"
+        << "\n"
+        << "Keys while running:\n"
+        << "  Up, Down             double or halve the FFT size\n"
+        << "  Right, Left          double or halve the FFT rate\n"
+        << "  W                    switch to the next window function\n"
+        << "  Tab                  select the next view for the keys above\n";
+}
@@ -0,0 +1,87 @@
+#ifndef WFALL_OPTIONS_H
+#define WFALL_OPTIONS_H
+
+#include <iostream>
+#include <string>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "format.h"
+#include "buffered.h"
+#include "average.h"
+#include "window.h"
+#include "rebin.h"
+
+/**
+ * The FFT settings of one panel of the display.
+ */
+struct ViewOptions {
+    std::size_t fft_size;
+    float fft_rate;
+    WindowSpec window;
+};
+
+/**
+ * Command line options.
+ */
+struct Options {
+    std::string input;
+    std::string rtl_tcp;
+    std::optional<std::size_t> rtl_freq;
+    std::optional<float> rtl_gain;
+    std::string udp;
+    bool udp_seq = false;
+    StreamFormat format;
+    float rate = 44100.0f;
+    float buffer = 1.0f;
+    DropPolicy drop = DropPolicy::Block;
+    bool uring = false;
+    unsigned uring_depth = 4;
+    std::string fir;
+    std::size_t fir_block = 1024;
+    std::optional<float> ddc;
+    std::size_t ddc_decim = 8;
+    std::size_t halfband = 0;
+    std::optional<float> resample;
+    /** Run the input and every processing stage on a thread of its own. */
+    bool stage_threads = false;
+    float fft_rate = 12.0f;
+    std::size_t fft_size = 4096;
+    std::size_t pfb_taps = 1;
+    WindowSpec window;
+    /** Unset for the default of the display or the batch mode. */
+    std::optional<std::size_t> fft_threads;
+    AverageMode average = AverageMode::None;
+    std::size_t average_count = 4;
+    float alpha = 0.25f;
+    bool psd = false;
+    std::size_t welch = 0;
+    /** Lowest frequency of the constant-Q transform in Hz, if any. */
+    std::optional<float> cqt_freq;
+    std::size_t cqt_bins_per_octave = 24;
+    /** Frequency axis to rebin the spectra to, if any. */
+    std::optional<AxisSpec> axis;
+    std::optional<std::pair<float, float>> db_range;
+    /** Views shown below the one of fft_size, fft_rate and window. */
+    std::vector<ViewOptions> views;
+    /** Spectrogram file to write instead of showing a window, if any. */
+    std::string output;
+    bool latency = false;
+    bool help = false;
+};
+
+/**
+ * Parses the command line.
+ *
+ * Throws std::invalid_argument if an option is unknown or has an
+ * invalid value.
+ */
+Options parse_options(int argc, char** argv);
+
+/**
+ * Prints a description of the command line options.
+ */
+void print_usage(std::ostream& out, const char* name);
+
+#endif /* WFALL_OPTIONS_H */
@@ -0,0 +1,309 @@
+#include "pipeline.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+PortBase::PortBase(Stage& stage, std::string name, std::size_t lanes, bool output)
+    : _stage(stage), _name(stage.name() + "." + name), _lanes(lanes)
+{
+    if (lanes == 0) {
+        throw std::invalid_argument("Port " + _name + " needs at least one lane");
+    }
+    (output ? stage._outputs : stage._inputs).push_back(this);
+}
+
+void PortBase::wake_peer()
+{
+    if (_peer && _peer->_wakeup) {
+        _peer->_wakeup->signal();
+    }
+}
+
+void PortBase::waited(std::chrono::steady_clock::duration time)
+{
+    _stage._wait_ns.fetch_add(std::chrono::nanoseconds(time).count(), std::memory_order_relaxed);
+}
+
+Stage::Step Stage::run()
+{
+    auto start = std::chrono::steady_clock::now();
+    int64_t waited = _wait_ns.load(std::memory_order_relaxed);
+
+    Step step = process();
+
+    int64_t elapsed = std::chrono::nanoseconds(std::chrono::steady_clock::now() - start).count();
+    waited = _wait_ns.load(std::memory_order_relaxed) - waited;
+    _busy_ns.fetch_add(std::max<int64_t>(elapsed - waited, 0), std::memory_order_relaxed);
+
+    return step;
+}
+
+void Stage::close_outputs()
+{
+    for (PortBase* port : _outputs) {
+        port->close();
+    }
+}
+
+std::size_t PortStream::lanes() const
+{
+    return _port.lanes();
+}
+
+void PortStream::read(OutSample* const* out, std::size_t count)
+{
+    std::size_t done = 0;
+    while (done < count) {
+        std::size_t n = std::min(_port.read_contiguous(), count - done);
+        if (n == 0) {
+            if (!_port.wait_readable(1)) {
+                break;
+            }
+            continue;
+        }
+
+        for (std::size_t l = 0; l < lanes(); l++) {
+            std::copy_n(_port.read_ptr(l), n, out[l] + done);
+        }
+        _port.consume(n);
+        done += n;
+    }
+
+    // Past the end of the input the stream is silent.
+    if (done < count) {
+        _eof = true;
+        for (std::size_t l = 0; l < lanes(); l++) {
+            std::fill(out[l] + done, out[l] + count, OutSample());
+        }
+    }
+}
+
+void PortStream::skip(std::size_t count)
+{
+    while (count > 0) {
+        std::size_t n = std::min(_port.read_contiguous(), count);
+        if (n == 0) {
+            if (!_port.wait_readable(1)) {
+                _eof = true;
+                return;
+            }
+            continue;
+        }
+
+        _port.consume(n);
+        count -= n;
+    }
+}
+
+bool PortStream::eof() const
+{
+    return _eof;
+}
+
+StreamSource::StreamSource(std::string name, Stream& stream, std::size_t chunk)
+    : Stage(std::move(name)), _stream(stream), _chunk(chunk), _ptrs(stream.lanes()),
+      out(*this, "out", stream.lanes())
+{
+    if (chunk == 0) {
+        throw std::invalid_argument("StreamSource needs a non-zero chunk size");
+    }
+}
+
+Stage::Step StreamSource::process()
+{
+    if (_stream.eof() || !out.wait_writable(_chunk)) {
+        return {false, true};
+    }
+
+    std::size_t count = std::min(_chunk, out.write_contiguous());
+    for (std::size_t l = 0; l < _ptrs.size(); l++) {
+        _ptrs[l] = out.write_ptr(l);
+    }
+    _stream.read(_ptrs.data(), count);
+    out.commit(count);
+
+    return {true, false};
+}
+
+StreamStage::StreamStage(std::string name, const Make& make, std::size_t lanes, std::size_t chunk)
+    : Stage(std::move(name)), _chunk(chunk), in(*this, "in", lanes),
+      out(*this, "out", lanes)
+{
+    if (chunk == 0) {
+        throw std::invalid_argument("StreamStage needs a non-zero chunk size");
+    }
+
+    _input = std::make_unique<PortStream>(in);
+    _stream = make(*_input);
+    if (_stream->lanes() != lanes) {
+        throw std::invalid_argument("Stage " + this->name() + " changes the number of lanes");
+    }
+    _ptrs.resize(lanes);
+}
+
+Stage::Step StreamStage::process()
+{
+    if (_stream->eof() || !out.wait_writable(_chunk)) {
+        return {false, true};
+    }
+
+    std::size_t count = std::min(_chunk, out.write_contiguous());
+    for (std::size_t l = 0; l < _ptrs.size(); l++) {
+        _ptrs[l] = out.write_ptr(l);
+    }
+    _stream->read(_ptrs.data(), count);
+    out.commit(count);
+
+    return {true, false};
+}
+
+StreamSink::StreamSink(std::string name, std::size_t lanes)
+    : Stage(std::move(name)), in(*this, "in", lanes), _stream(in) {}
+
+Pipeline::~Pipeline()
+{
+    stop();
+    wait();
+}
+
+std::size_t Pipeline::index(const Stage& stage) const
+{
+    for (std::size_t i = 0; i < _stages.size(); i++) {
+        if (_stages[i].get() == &stage) {
+            return i;
+        }
+    }
+
+    throw std::invalid_argument("Stage " + stage.name() + " is not part of the pipeline");
+}
+
+void Pipeline::fuse(Stage& a, Stage& b)
+{
+    for (const Stage* stage : {&a, &b}) {
+        if (stage->blocking() || stage->passive()) {
+            throw std::invalid_argument("Stage " + stage->name() + " can not share a thread");
+        }
+    }
+
+    std::size_t from = _groups[index(b)];
+    std::size_t to = _groups[index(a)];
+    std::replace(_groups.begin(), _groups.end(), from, to);
+}
+
+void Pipeline::start()
+{
+    for (const auto& stage : _stages) {
+        for (const auto* ports : {&stage->_inputs, &stage->_outputs}) {
+            for (const PortBase* port : *ports) {
+                if (!port->connected()) {
+                    throw std::logic_error("Port " + port->name() + " is not connected");
+                }
+            }
+        }
+    }
+
+    // Groups are numbered by the index of one of their stages. The
+    // wakeups are all set before any thread starts, since the stages wake
+    // up each other.
+    std::vector<std::vector<Stage*>> groups;
+    for (std::size_t g = 0; g < _stages.size(); g++) {
+        std::vector<Stage*> group;
+        for (std::size_t i = 0; i < _stages.size(); i++) {
+            if (_groups[i] == g && !_stages[i]->passive()) {
+                group.push_back(_stages[i].get());
+            }
+        }
+        if (group.empty()) {
+            continue;
+        }
+
+        Wakeup& wakeup = *_wakeups.emplace_back(std::make_unique<Wakeup>());
+        for (Stage* stage : group) {
+            stage->_wakeup = &wakeup;
+        }
+        groups.push_back(std::move(group));
+    }
+
+    _start = Clock::now();
+    for (std::size_t g = 0; g < groups.size(); g++) {
+        _threads.emplace_back(&Pipeline::run_group, this, std::move(groups[g]), std::ref(*_wakeups[g]));
+    }
+}
+
+void Pipeline::run_group(std::vector<Stage*> stages, Wakeup& wakeup)
+{
+    std::vector<bool> done(stages.size());
+    std::size_t running = stages.size();
+
+    while (running > 0 && !_stopping) {
+        uint32_t events = wakeup.events();
+        bool progress = false;
+
+        for (std::size_t i = 0; i < stages.size(); i++) {
+            if (done[i]) {
+                continue;
+            }
+
+            Stage::Step step = stages[i]->run();
+            progress |= step.progress;
+            if (step.done) {
+                stages[i]->close_outputs();
+                done[i] = true;
+                running--;
+                progress = true;
+            }
+        }
+
+        // Nothing moved, so wait until a queue of the group does.
+        if (!progress) {
+            wakeup.wait(events);
+        }
+    }
+}
+
+void Pipeline::stop()
+{
+    _stopping = true;
+    for (const auto& stage : _stages) {
+        for (PortBase* port : stage->_inputs) {
+            port->close();
+        }
+        stage->close_outputs();
+    }
+    for (const auto& wakeup : _wakeups) {
+        wakeup->signal();
+    }
+}
+
+void Pipeline::wait()
+{
+    for (std::thread& thread : _threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+std::vector<StageStats> Pipeline::stats() const
+{
+    std::chrono::duration<double> elapsed = Clock::now() - _start;
+
+    std::vector<StageStats> stats;
+    for (const auto& stage : _stages) {
+        StageStats s;
+        s.name = stage->name();
+        s.inputs = stage->_inputs.size();
+        s.outputs = stage->_outputs.size();
+        for (const PortBase* port : stage->_inputs) {
+            s.items_in += port->items();
+        }
+        for (const PortBase* port : stage->_outputs) {
+            s.items_out += port->items();
+        }
+        s.busy = stage->_busy_ns.load(std::memory_order_relaxed) * 1e-9;
+        s.elapsed = elapsed.count();
+        stats.push_back(s);
+    }
+
+    return stats;
+}
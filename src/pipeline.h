@@ -0,0 +1,598 @@
+#ifndef WFALL_PIPELINE_H
+#define WFALL_PIPELINE_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+
+#include "ring.h"
+#include "fftseq.h"
+
+class Stage;
+
+/**
+ * Wakes up the thread that runs a group of stages when one of their
+ * queues changes.
+ */
+class Wakeup {
+    std::atomic<uint32_t> _events = 0;
+
+public:
+    uint32_t events() const { return _events.load(); }
+
+    void signal()
+    {
+        _events.fetch_add(1);
+        _events.notify_all();
+    }
+
+    /**
+     * Blocks until signal() is called, unless it has been called since
+     * events() returned events.
+     */
+    void wait(uint32_t events) { _events.wait(events); }
+};
+
+/**
+ * The part of a port that does not depend on the type of its items.
+ *
+ * A port registers itself with the stage it is a member of, so that the
+ * pipeline can check that every port is connected, wake up the stages at
+ * both ends of a queue, close the queues of a stage that is done and
+ * count the items that pass through.
+ */
+class PortBase {
+protected:
+    Stage& _stage;
+    std::string _name;
+    std::size_t _lanes;
+    std::atomic<uint64_t> _items = 0;
+    Stage* _peer = nullptr;
+
+    friend class Pipeline;
+
+    /**
+     * Wakes up the stage at the other end of the queue.
+     */
+    void wake_peer();
+
+    /**
+     * Adds the time spent waiting on the queue to the stage, which is not
+     * counted as busy.
+     */
+    void waited(std::chrono::steady_clock::duration time);
+
+public:
+    PortBase(Stage& stage, std::string name, std::size_t lanes, bool output);
+    virtual ~PortBase() = default;
+
+    PortBase(const PortBase&) = delete;
+    PortBase& operator=(const PortBase&) = delete;
+
+    const std::string& name() const { return _name; }
+    std::size_t lanes() const { return _lanes; }
+
+    /**
+     * Returns the number of items that have passed through the port.
+     */
+    uint64_t items() const { return _items.load(std::memory_order_relaxed); }
+
+    virtual bool connected() const = 0;
+
+    /**
+     * Closes the queue, which releases the stage at the other end once it
+     * has read what is left.
+     */
+    virtual void close() = 0;
+};
+
+/**
+ * An output of a stage, which writes items of type T into a bounded
+ * single-producer/single-consumer queue, see SpscRing. Every item has one
+ * value per lane.
+ */
+template <typename T>
+class OutPort : public PortBase {
+    std::shared_ptr<SpscRing<T>> _queue;
+
+    friend class Pipeline;
+
+public:
+    OutPort(Stage& stage, std::string name, std::size_t lanes = 1)
+        : PortBase(stage, std::move(name), lanes, true) {}
+
+    bool connected() const override { return _queue != nullptr; }
+
+    std::size_t writable() const { return _queue->writable(); }
+    std::size_t write_contiguous() const { return _queue->write_contiguous(); }
+    T* write_ptr(std::size_t lane) { return _queue->write_ptr(lane); }
+
+    /**
+     * Publishes count items written at write_ptr().
+     */
+    void commit(std::size_t count)
+    {
+        _queue->commit(count);
+        _items.fetch_add(count, std::memory_order_relaxed);
+        wake_peer();
+    }
+
+    /**
+     * Blocks until count items can be written, for stages that run on a
+     * thread of their own. Returns false if the queue was closed first.
+     */
+    bool wait_writable(std::size_t count)
+    {
+        auto start = std::chrono::steady_clock::now();
+        bool ok = _queue->wait_writable(std::min(count, _queue->capacity()));
+        waited(std::chrono::steady_clock::now() - start);
+        return ok;
+    }
+
+    std::size_t capacity() const { return _queue->capacity(); }
+
+    void close() override
+    {
+        if (_queue) {
+            _queue->close();
+            wake_peer();
+        }
+    }
+};
+
+/**
+ * An input of a stage, which reads the items that the connected OutPort
+ * writes.
+ */
+template <typename T>
+class InPort : public PortBase {
+    std::shared_ptr<SpscRing<T>> _queue;
+
+    friend class Pipeline;
+
+public:
+    InPort(Stage& stage, std::string name, std::size_t lanes = 1)
+        : PortBase(stage, std::move(name), lanes, false) {}
+
+    bool connected() const override { return _queue != nullptr; }
+
+    std::size_t readable() const { return _queue->readable(); }
+    std::size_t read_contiguous() const { return _queue->read_contiguous(); }
+    const T* read_ptr(std::size_t lane) const { return _queue->read_ptr(lane); }
+
+    /**
+     * Releases the count oldest items.
+     */
+    void consume(std::size_t count)
+    {
+        _queue->consume(count);
+        _items.fetch_add(count, std::memory_order_relaxed);
+        wake_peer();
+    }
+
+    /**
+     * Blocks until count items can be read, for stages that run on a
+     * thread of their own. Returns false if the queue was closed first.
+     */
+    bool wait_readable(std::size_t count)
+    {
+        auto start = std::chrono::steady_clock::now();
+        bool ok = _queue->wait_readable(count);
+        waited(std::chrono::steady_clock::now() - start);
+        return ok;
+    }
+
+    /**
+     * Returns true once the producer has closed the queue and every item
+     * has been read.
+     */
+    bool finished() const { return _queue->closed() && _queue->readable() == 0; }
+
+    void close() override
+    {
+        if (_queue) {
+            _queue->close();
+            wake_peer();
+        }
+    }
+};
+
+/**
+ * A processing step of a Pipeline.
+ *
+ * A stage declares its ports as members, and does its work in process(),
+ * which the pipeline calls over and over from the thread that runs it.
+ * Stages that can share a thread with others must not block in process():
+ * they do what the items in their inputs and the room in their outputs
+ * allow and return. Stages that block, for example on a Stream, say so
+ * with blocking() and get a thread of their own.
+ */
+class Stage {
+public:
+    /**
+     * The outcome of a call to process().
+     */
+    struct Step {
+        /** Something was read or written. */
+        bool progress = false;
+        /** The stage has nothing more to do, its outputs are closed. */
+        bool done = false;
+    };
+
+private:
+    friend class PortBase;
+    friend class Pipeline;
+
+    std::string _name;
+    std::vector<PortBase*> _inputs;
+    std::vector<PortBase*> _outputs;
+    Wakeup* _wakeup = nullptr;
+
+    std::atomic<int64_t> _busy_ns = 0;
+    std::atomic<int64_t> _wait_ns = 0;
+
+protected:
+    virtual Step process() = 0;
+
+public:
+    explicit Stage(std::string name) : _name(std::move(name)) {}
+    virtual ~Stage() = default;
+
+    Stage(const Stage&) = delete;
+    Stage& operator=(const Stage&) = delete;
+
+    const std::string& name() const { return _name; }
+
+    /**
+     * Returns true if process() may block, so that the stage needs a
+     * thread of its own.
+     */
+    virtual bool blocking() const { return false; }
+
+    /**
+     * Returns true if the pipeline does not run the stage, because it is
+     * driven from outside, like a StreamSink.
+     */
+    virtual bool passive() const { return false; }
+
+    /**
+     * Calls process() and adds the time it took, less the time it waited
+     * on its ports, to the busy time of the stage.
+     */
+    Step run();
+
+    /**
+     * Closes all outputs of the stage.
+     */
+    void close_outputs();
+};
+
+/**
+ * A stage that transforms blocks of items one to one, lane by lane, with
+ * fn(in, out, count, lane). It never blocks, so it can be fused with the
+ * stages around it.
+ */
+template <typename In, typename Out>
+class BlockStage : public Stage {
+public:
+    using Fn = std::function<void(const In* in, Out* out, std::size_t count, std::size_t lane)>;
+
+private:
+    Fn _fn;
+
+public:
+    InPort<In> in;
+    OutPort<Out> out;
+
+    BlockStage(std::string name, Fn fn, std::size_t lanes = 1)
+        : Stage(std::move(name)), _fn(std::move(fn)), in(*this, "in", lanes), out(*this, "out", lanes) {}
+
+protected:
+    Step process() override
+    {
+        std::size_t count = std::min(in.read_contiguous(), out.write_contiguous());
+        if (count == 0) {
+            return {false, in.finished()};
+        }
+
+        for (std::size_t l = 0; l < in.lanes(); l++) {
+            _fn(in.read_ptr(l), out.write_ptr(l), count, l);
+        }
+        in.consume(count);
+        out.commit(count);
+
+        return {true, false};
+    }
+};
+
+/**
+ * A Stream that reads the samples of an InPort, so that the stages of this
+ * repository that process a Stream can read from a pipeline.
+ *
+ * The stream ends when the producer closes the queue and it has been read
+ * empty. The arrival of the samples is not carried through the queue, so
+ * arrival() is the time at which they are read.
+ */
+class PortStream : public Stream {
+    InPort<OutSample>& _port;
+    bool _eof = false;
+
+public:
+    explicit PortStream(InPort<OutSample>& port) : _port(port) {}
+
+    std::size_t lanes() const override;
+    void read(OutSample* const* out, std::size_t count) override;
+    void skip(std::size_t count) override;
+    bool eof() const override;
+};
+
+/**
+ * Reads a Stream into the pipeline in chunks.
+ */
+class StreamSource : public Stage {
+    Stream& _stream;
+    std::size_t _chunk;
+    std::vector<Stream::OutSample*> _ptrs;
+
+public:
+    OutPort<Stream::OutSample> out;
+
+    StreamSource(std::string name, Stream& stream, std::size_t chunk);
+
+    bool blocking() const override { return true; }
+
+protected:
+    Step process() override;
+};
+
+/**
+ * Runs a Stream stage, such as a DdcStream or a ResampleStream, inside the
+ * pipeline. make() is given the Stream of the input port and returns the
+ * stage reading from it, whose output is written to the output port in
+ * chunks.
+ */
+class StreamStage : public Stage {
+public:
+    using Make = std::function<std::unique_ptr<Stream>(Stream& source)>;
+
+private:
+    std::size_t _chunk;
+    std::unique_ptr<PortStream> _input;
+    std::unique_ptr<Stream> _stream;
+    std::vector<Stream::OutSample*> _ptrs;
+
+public:
+    InPort<Stream::OutSample> in;
+    OutPort<Stream::OutSample> out;
+
+    /**
+     * ctor. lanes is the number of lanes of the input.
+     */
+    StreamStage(std::string name, const Make& make, std::size_t lanes, std::size_t chunk);
+
+    bool blocking() const override { return true; }
+
+protected:
+    Step process() override;
+};
+
+/**
+ * The end of a pipeline, read as a Stream by whoever consumes its output,
+ * for example a SampleFeed.
+ */
+class StreamSink : public Stage {
+public:
+    InPort<Stream::OutSample> in;
+
+private:
+    PortStream _stream;
+
+public:
+
+    StreamSink(std::string name, std::size_t lanes);
+
+    bool passive() const override { return true; }
+
+    Stream& stream() { return _stream; }
+
+protected:
+    Step process() override { return {}; }
+};
+
+/**
+ * Throughput counters of a stage, counted since the pipeline was
+ * started.
+ */
+struct StageStats {
+    std::string name;
+    std::size_t inputs = 0;
+    std::size_t outputs = 0;
+    /** Items read from all inputs and written to all outputs. */
+    uint64_t items_in = 0;
+    uint64_t items_out = 0;
+    /** Time spent processing, not counting waits on full or empty queues. */
+    double busy = 0.0;
+    double elapsed = 0.0;
+};
+
+/**
+ * A graph of stages connected by bounded queues.
+ *
+ * Stages are added with add() and their ports connected with connect(),
+ * which only compiles for ports of the same item type. By default every
+ * stage runs on a thread of its own, so that the stages of a chain work in
+ * parallel on successive blocks. Stages that are cheap compared to the
+ * cost of handing items between threads can be fused onto one thread with
+ * fuse(), which then runs them in turn.
+ *
+ * A stage that is done closes its outputs, and the stages after it finish
+ * what is left in their queues and are done in turn, so the end of the
+ * input flows through the pipeline. stop() ends it early.
+ *
+ * Each stage counts the items that pass its ports and the time it is
+ * busy, see stats(), which shows which stage limits the throughput.
+ */
+class Pipeline {
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<std::unique_ptr<Stage>> _stages;
+    /** The thread group of every stage, by index. */
+    std::vector<std::size_t> _groups;
+    std::vector<std::unique_ptr<Wakeup>> _wakeups;
+    std::vector<std::thread> _threads;
+    std::atomic<bool> _stopping = false;
+    Clock::time_point _start;
+
+    std::size_t index(const Stage& stage) const;
+
+    void run_group(std::vector<Stage*> stages, Wakeup& wakeup);
+
+public:
+    Pipeline() = default;
+    ~Pipeline();
+
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    /**
+     * Constructs a stage owned by the pipeline and returns it.
+     */
+    template <typename S, typename... Args>
+    S& add(Args&&... args)
+    {
+        auto stage = std::make_unique<S>(std::forward<Args>(args)...);
+        S& ref = *stage;
+        _groups.push_back(_stages.size());
+        _stages.push_back(std::move(stage));
+        return ref;
+    }
+
+    /**
+     * Connects an output to an input with a queue of capacity items.
+     *
+     * Throws std::invalid_argument if a port is already connected or the
+     * ports have different numbers of lanes.
+     */
+    template <typename T>
+    void connect(OutPort<T>& out, InPort<T>& in, std::size_t capacity)
+    {
+        if (out.connected() || in.connected()) {
+            throw std::invalid_argument("Port " + out.name() + " or " + in.name() + " is already connected");
+        }
+        if (out.lanes() != in.lanes()) {
+            throw std::invalid_argument("Port " + out.name() + " has " + std::to_string(out.lanes())
+                    + " lanes, but " + in.name() + " has " + std::to_string(in.lanes()));
+        }
+
+        out._queue = in._queue = std::make_shared<SpscRing<T>>(capacity, out.lanes());
+        out._peer = &in._stage;
+        in._peer = &out._stage;
+    }
+
+    /**
+     * Runs b on the same thread as a, and every stage fused with either.
+     *
+     * Throws std::invalid_argument if either stage blocks or is passive.
+     */
+    void fuse(Stage& a, Stage& b);
+
+    /**
+     * Starts the threads.
+     *
+     * Throws std::logic_error if a port is not connected.
+     */
+    void start();
+
+    /**
+     * Closes every queue and wakes up every stage, which ends the
+     * pipeline without waiting for the input to run out.
+     */
+    void stop();
+
+    /**
+     * Waits for every stage to be done.
+     */
+    void wait();
+
+    std::vector<StageStats> stats() const;
+};
+
+/**
+ * Builds a chain of Stream stages after an input, either pulled by whoever
+ * reads the end of the chain, as usual, or as stages of a pipeline that
+ * each run on a thread of their own.
+ */
+class StreamChain {
+    Pipeline* _pipeline = nullptr;
+    std::size_t _chunk = 0;
+    std::size_t _capacity = 0;
+    OutPort<Stream::OutSample>* _port = nullptr;
+    Stream* _source;
+    std::vector<std::unique_ptr<Stream>> _stages;
+
+public:
+    /**
+     * Makes a chain that is pulled.
+     */
+    explicit StreamChain(Stream& input) : _source(&input) {}
+
+    /**
+     * Makes a chain of stages in pipeline, which reads input in chunks of
+     * chunk samples and queues up to capacity samples between stages.
+     */
+    StreamChain(Stream& input, Pipeline& pipeline, std::size_t chunk, std::size_t capacity)
+        : _pipeline(&pipeline), _chunk(chunk), _capacity(capacity), _source(nullptr)
+    {
+        _port = &pipeline.add<StreamSource>("input", input, chunk).out;
+    }
+
+    /**
+     * Appends a stage S, constructed from the stream before it and args,
+     * and returns it.
+     */
+    template <typename S, typename... Args>
+    S& add(const std::string& name, Args&&... args)
+    {
+        S* ref;
+        auto make = [&](Stream& source) {
+            auto stage = std::make_unique<S>(source, std::forward<Args>(args)...);
+            ref = stage.get();
+            return stage;
+        };
+
+        if (!_pipeline) {
+            _source = _stages.emplace_back(make(*_source)).get();
+            return *ref;
+        }
+
+        auto& stage = _pipeline->add<StreamStage>(name, make, _port->lanes(), _chunk);
+        _pipeline->connect(*_port, stage.in, _capacity);
+        _port = &stage.out;
+        return *ref;
+    }
+
+    /**
+     * Returns the end of the chain. For a pipeline this adds the sink, so
+     * it is called once, when the chain is complete.
+     */
+    Stream& end()
+    {
+        if (_pipeline) {
+            auto& sink = _pipeline->add<StreamSink>("output", _port->lanes());
+            _pipeline->connect(*_port, sink.in, _capacity);
+            _source = &sink.stream();
+            _pipeline = nullptr;
+        }
+
+        return *_source;
+    }
+};
+
+#endif /* WFALL_PIPELINE_H */
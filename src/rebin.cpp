@@ -0,0 +1,179 @@
+#include "rebin.h"
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+
+AxisSpec parse_axis(const std::string& name)
+{
+    std::size_t sep = name.find(':');
+    std::string scale = name.substr(0, sep);
+
+    AxisSpec spec;
+    if (scale == "linear") {
+        spec.scale = FreqScale::Linear;
+    } else if (scale == "log") {
+        spec.scale = FreqScale::Log;
+    } else if (scale == "mel") {
+        spec.scale = FreqScale::Mel;
+    } else if (scale == "bark") {
+        spec.scale = FreqScale::Bark;
+    } else {
+        throw std::invalid_argument("Unknown frequency scale: " + name);
+    }
+
+    while (sep != std::string::npos) {
+        std::size_t next = name.find(',', sep + 1);
+        std::string value = name.substr(sep + 1, next - sep - 1);
+        try {
+            std::size_t pos;
+            spec.points.push_back(std::stof(value, &pos));
+            if (pos != value.size()) {
+                throw std::invalid_argument(value);
+            }
+        } catch (const std::logic_error&) {
+            throw std::invalid_argument("Invalid frequency for the " + scale + " scale: " + value);
+        }
+        sep = next;
+    }
+
+    if (spec.points.size() == 1) {
+        throw std::invalid_argument("The " + scale + " scale needs at least two frequencies");
+    }
+
+    return spec;
+}
+
+std::string axis_name(const AxisSpec& spec)
+{
+    std::string name;
+    switch (spec.scale) {
+        case FreqScale::Linear: name = "linear"; break;
+        case FreqScale::Log: name = "log"; break;
+        case FreqScale::Mel: name = "mel"; break;
+        case FreqScale::Bark: name = "bark"; break;
+    }
+
+    for (std::size_t i = 0; i < spec.points.size(); i++) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%g", spec.points[i]);
+        name += (i == 0 ? ":" : ",");
+        name += buf;
+    }
+
+    return name;
+}
+
+void check_axis(const AxisSpec& spec, bool two_sided)
+{
+    if (spec.width == 0) {
+        return;
+    }
+    if (spec.rate <= 0.0f) {
+        throw std::invalid_argument("The frequency axis needs a positive sample rate");
+    }
+    if (two_sided && spec.scale != FreqScale::Linear) {
+        throw std::invalid_argument("Only a linear frequency axis can show both halves of the spectrum");
+    }
+
+    // The log scale can not reach zero, nor negative frequencies.
+    const float nyquist = spec.rate / 2.0f;
+    const float lowest = two_sided ? -nyquist : 0.0f;
+    for (std::size_t i = 0; i < spec.points.size(); i++) {
+        float f = spec.points[i];
+        if (f < lowest || f > nyquist || (spec.scale == FreqScale::Log && f <= 0.0f)) {
+            throw std::invalid_argument("Frequency out of range for the axis");
+        }
+        if (i > 0 && f <= spec.points[i - 1]) {
+            throw std::invalid_argument("The frequencies of an axis must increase");
+        }
+    }
+    if (spec.points.size() == 1) {
+        throw std::invalid_argument("An axis needs at least two frequencies");
+    }
+}
+
+/**
+ * Maps a frequency in Hz onto the scale, on which the axis is evenly
+ * spaced.
+ */
+static double warp(FreqScale scale, double f)
+{
+    switch (scale) {
+        case FreqScale::Log: return std::log(f);
+        case FreqScale::Mel: return 2595.0 * std::log10(1.0 + f / 700.0);
+        case FreqScale::Bark: return 26.81 * f / (1960.0 + f) - 0.53;
+        default: return f;
+    }
+}
+
+/**
+ * The inverse of warp.
+ */
+static double unwarp(FreqScale scale, double x)
+{
+    switch (scale) {
+        case FreqScale::Log: return std::exp(x);
+        case FreqScale::Mel: return 700.0 * (std::pow(10.0, x / 2595.0) - 1.0);
+        case FreqScale::Bark: return 1960.0 * (x + 0.53) / (26.28 - x);
+        default: return x;
+    }
+}
+
+double axis_freq(const AxisSpec& spec, bool two_sided, double x)
+{
+    std::vector<double> points(spec.points.begin(), spec.points.end());
+    if (points.empty()) {
+        const double nyquist = spec.rate / 2.0;
+        if (spec.scale == FreqScale::Log) {
+            points = {nyquist / 1000.0, nyquist};
+        } else {
+            points = {two_sided ? -nyquist : 0.0, nyquist};
+        }
+    }
+
+    const double pos = std::clamp(x, 0.0, 1.0) * (points.size() - 1);
+    const std::size_t i = std::min<std::size_t>(pos, points.size() - 2);
+    const double lo = warp(spec.scale, points[i]);
+    const double hi = warp(spec.scale, points[i + 1]);
+
+    return unwarp(spec.scale, lo + (pos - i) * (hi - lo));
+}
+
+CsrMatrix<float> rebin_matrix(const AxisSpec& spec, std::size_t fft_size, bool two_sided)
+{
+    check_axis(spec, two_sided);
+
+    // Positions are in FFT bins, bin j covers j - 0.5 to j + 0.5. The
+    // two-sided spectrum starts at minus half the sample rate.
+    const std::size_t bins = two_sided ? fft_size : fft_size / 2;
+    const double offset = two_sided ? fft_size / 2 : 0.0;
+    auto position = [&](double x) {
+        return axis_freq(spec, two_sided, x) * fft_size / spec.rate + offset;
+    };
+
+    CsrMatrix<float> matrix(bins);
+    double left = position(0.0);
+    for (std::size_t i = 0; i < spec.width; i++) {
+        double right = position(double(i + 1) / spec.width);
+
+        // An axis bin is widened to at least one FFT bin around its
+        // center, which interpolates linearly between the nearest two.
+        double center = std::clamp(0.5 * (left + right), 0.0, bins - 1.0);
+        double lo = std::max(std::min(left, center - 0.5), -0.5);
+        double hi = std::min(std::max(right, center + 0.5), bins - 0.5);
+
+        for (std::size_t j = std::lround(std::max(lo, 0.0)); j < bins && j - 0.5 < hi; j++) {
+            double overlap = std::min(hi, j + 0.5) - std::max(lo, j - 0.5);
+            if (overlap > 0.0) {
+                matrix.push(j, overlap / (hi - lo));
+            }
+        }
+        matrix.end_row();
+
+        left = right;
+    }
+
+    return matrix;
+}
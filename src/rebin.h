@@ -0,0 +1,82 @@
+#ifndef WFALL_REBIN_H
+#define WFALL_REBIN_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+#include "sparse.h"
+
+/**
+ * The frequency scales that a spectrum can be rebinned to.
+ */
+enum class FreqScale {
+    Linear,
+    /** Logarithmic, piecewise between the points of the axis. */
+    Log,
+    /** Mel, 2595 log10(1 + f / 700). */
+    Mel,
+    /** Bark, after Traunmüller (1990). */
+    Bark,
+};
+
+/**
+ * A frequency axis of width bins, spaced evenly on the scale.
+ *
+ * points holds the frequencies, in Hz at the sample rate rate, that are
+ * spread evenly over the width, at least the lowest and the highest.
+ * Without points the axis spans the whole spectrum, except on the log
+ * scale, which can not reach zero and spans the three decades below half
+ * the sample rate. With more than two points every interval between two
+ * of them gets the same width, so that for example the octaves of interest
+ * can be given more room than the rest.
+ */
+struct AxisSpec {
+    FreqScale scale = FreqScale::Linear;
+    /** Number of bins, 0 disables the rebinning. */
+    std::size_t width = 0;
+    float rate = 1.0f;
+    std::vector<float> points;
+
+    bool operator==(const AxisSpec&) const = default;
+};
+
+/**
+ * Parses a scale name, optionally followed by a list of frequencies in
+ * Hz: "linear", "log", "mel" or "bark", then ":F1,F2,...". The width and
+ * rate are left for the caller to set.
+ *
+ * Throws std::invalid_argument for unknown names or bad frequencies.
+ */
+AxisSpec parse_axis(const std::string& name);
+
+/**
+ * Returns the name of the scale, in the form parse_axis takes.
+ */
+std::string axis_name(const AxisSpec& spec);
+
+/**
+ * Throws std::invalid_argument if the axis is not valid for a spectrum
+ * that is two_sided or not.
+ */
+void check_axis(const AxisSpec& spec, bool two_sided);
+
+/**
+ * Returns the frequency in Hz at position x of the axis, from 0 at its
+ * lower edge to 1 at its upper edge.
+ */
+double axis_freq(const AxisSpec& spec, bool two_sided, double x);
+
+/**
+ * Computes the matrix that rebins the power spectrum of an FFT of
+ * fft_size, as written by power_spectrum, onto the axis.
+ *
+ * Every bin of the axis averages the power over the frequencies it
+ * covers, weighting each FFT bin by its overlap. Where the axis bins are
+ * narrower than the FFT bins, which happens at the low end of log scales,
+ * they interpolate linearly between the FFT bins instead. Either way a
+ * flat spectrum stays flat.
+ */
+CsrMatrix<float> rebin_matrix(const AxisSpec& spec, std::size_t fft_size, bool two_sided);
+
+#endif /* WFALL_REBIN_H */
@@ -0,0 +1,180 @@
+#include "resample.h"
+
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <algorithm>
+
+/**
+ * Finds up / down close to ratio with up no larger than max_up, using
+ * the convergents of the continued fraction of ratio.
+ */
+static std::pair<uint64_t, uint64_t> rational_approx(double ratio, uint64_t max_up)
+{
+    uint64_t p0 = 0, q0 = 1, p1 = 1, q1 = 0;
+    double x = ratio;
+    while (1) {
+        double a = std::floor(x);
+        uint64_t p2 = uint64_t(a) * p1 + p0;
+        uint64_t q2 = uint64_t(a) * q1 + q0;
+        if (p2 > max_up || q2 > (uint64_t(1) << 32)) {
+            break;
+        }
+        p0 = p1; q0 = q1;
+        p1 = p2; q1 = q2;
+
+        if (x - a < 1e-12) {
+            break;
+        }
+        x = 1.0 / (x - a);
+    }
+
+    if (q1 == 0) {
+        throw std::invalid_argument("Can not approximate the resampling ratio");
+    }
+
+    return {p1, q1};
+}
+
+ResampleStream::ResampleStream(Stream& source, double in_rate, double out_rate,
+        std::size_t taps_per_phase, std::size_t max_phases)
+    : _source(source), _taps(taps_per_phase)
+{
+    if (source.lanes() != 1) {
+        throw std::invalid_argument("ResampleStream needs a single lane source");
+    }
+    if (in_rate <= 0.0 || out_rate <= 0.0 || taps_per_phase == 0) {
+        throw std::invalid_argument("Invalid resampler parameters");
+    }
+
+    uint64_t in = std::llround(in_rate);
+    uint64_t out = std::llround(out_rate);
+    if (in == in_rate && out == out_rate && out / std::gcd(in, out) <= max_phases) {
+        uint64_t g = std::gcd(in, out);
+        _up = out / g;
+        _down = in / g;
+    } else {
+        std::tie(_up, _down) = rational_approx(out_rate / in_rate, max_phases);
+    }
+
+    // The prototype runs at up times the input rate and cuts off at the
+    // Nyquist frequency of the lower of the two rates. Its transition band
+    // narrows with the cutoff only if its length grows with it, so when
+    // decimating each phase gets taps_per_phase taps per output sample
+    // period instead of per input sample period.
+    _taps = taps_per_phase * ((_down + _up - 1) / _up);
+    std::size_t length = _up * _taps;
+    std::vector<float> h = design_lowpass(length, 0.5f / std::max(_up, _down));
+
+    // Phase p holds h[p], h[p + up], ... reversed, so that it lines up
+    // with the input samples oldest first.
+    _phases.resize(length);
+    for (std::size_t p = 0; p < _up; p++) {
+        for (std::size_t k = 0; k < _taps; k++) {
+            _phases[p * _taps + (_taps - 1 - k)] = h[p + k * _up] * _up;
+        }
+    }
+
+    _base = -int64_t(_taps - 1);
+    _re.assign(_taps - 1, 0.0f);
+    _im.assign(_taps - 1, 0.0f);
+}
+
+std::size_t ResampleStream::up() const
+{
+    return _up;
+}
+
+std::size_t ResampleStream::down() const
+{
+    return _down;
+}
+
+double ResampleStream::out_rate(double in_rate) const
+{
+    return in_rate * _up / _down;
+}
+
+int64_t ResampleStream::input_index(uint64_t n) const
+{
+    return int64_t(n * _down / _up);
+}
+
+void ResampleStream::discard_old()
+{
+    int64_t first = input_index(_pos) - int64_t(_taps - 1);
+    std::size_t drop = std::clamp<int64_t>(first - _base, 0, _re.size());
+
+    _re.erase(_re.begin(), _re.begin() + drop);
+    _im.erase(_im.begin(), _im.begin() + drop);
+    _base += drop;
+}
+
+void ResampleStream::read(OutSample* const* out, std::size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+
+    // Fetch all the input the outputs depend on in one read.
+    int64_t end = input_index(_pos + count - 1) + 1;
+    int64_t have = _base + int64_t(_re.size());
+    if (end > have) {
+        std::size_t n = end - have;
+        _in.resize(n);
+        OutSample* ptr = _in.data();
+        _source.read(&ptr, n);
+
+        std::size_t old = _re.size();
+        _re.resize(old + n);
+        _im.resize(old + n);
+        for (std::size_t i = 0; i < n; i++) {
+            _re[old + i] = _in[i].real();
+            _im[old + i] = _in[i].imag();
+        }
+    }
+
+    for (std::size_t j = 0; j < count; j++, _pos++) {
+        uint64_t t = _pos * _down;
+        const float* phase = _phases.data() + (t % _up) * _taps;
+        std::size_t start = int64_t(t / _up) - int64_t(_taps - 1) - _base;
+
+        out[0][j] = OutSample(
+                dot(phase, _re.data() + start, _taps),
+                dot(phase, _im.data() + start, _taps));
+    }
+
+    discard_old();
+}
+
+void ResampleStream::skip(std::size_t count)
+{
+    _pos += count;
+
+    int64_t first = input_index(_pos) - int64_t(_taps - 1);
+    int64_t have = _base + int64_t(_re.size());
+    if (first > have) {
+        // None of the buffered input is needed any more.
+        _source.skip(first - have);
+        _re.clear();
+        _im.clear();
+        _base = first;
+    } else {
+        discard_old();
+    }
+}
+
+Stream::Clock::time_point ResampleStream::arrival() const
+{
+    return _source.arrival();
+}
+
+bool ResampleStream::eof() const
+{
+    return _source.eof();
+}
+
+bool ResampleStream::behind() const
+{
+    return _source.behind();
+}
@@ -0,0 +1,70 @@
+#ifndef WFALL_RESAMPLE_H
+#define WFALL_RESAMPLE_H
+
+#include <cstdint>
+
+#include "fftseq.h"
+#include "dsp.h"
+
+/**
+ * A rational polyphase resampler.
+ *
+ * Wraps a Stream and converts it from one sample rate to another by the
+ * ratio up / down. Conceptually the input is upsampled by up, lowpass
+ * filtered and downsampled by down; only the filter phases that are
+ * needed for each output are evaluated. The phases are precomputed and
+ * stored reversed, so each output is a dense dot product with the most
+ * recent input samples.
+ */
+class ResampleStream : public Stream {
+    Stream& _source;
+    std::size_t _up;
+    std::size_t _down;
+    std::size_t _taps;
+    std::vector<float> _phases;
+    std::vector<float> _re;
+    std::vector<float> _im;
+    std::vector<OutSample> _in;
+    /** Index of the input sample held in _re[0] and _im[0]. */
+    int64_t _base;
+    /** Index of the next output sample. */
+    uint64_t _pos = 0;
+
+    /**
+     * Returns the index of the newest input sample output n depends on.
+     */
+    int64_t input_index(uint64_t n) const;
+
+    /**
+     * Drops buffered input that is older than what output _pos needs.
+     */
+    void discard_old();
+
+public:
+    /**
+     * ctor.
+     *
+     * Resamples from in_rate to out_rate. If the exact ratio needs more
+     * than max_phases filter phases it is approximated, see out_rate().
+     * Each phase has taps_per_phase taps, times ceil(down / up) when
+     * the rate goes down.
+     */
+    ResampleStream(Stream& source, double in_rate, double out_rate,
+            std::size_t taps_per_phase = 24, std::size_t max_phases = 1024);
+
+    std::size_t up() const;
+    std::size_t down() const;
+
+    /**
+     * Returns the actual output rate for the given input rate.
+     */
+    double out_rate(double in_rate) const;
+
+    void read(OutSample* const* out, std::size_t count) override;
+    void skip(std::size_t count) override;
+    Clock::time_point arrival() const override;
+    bool eof() const override;
+    bool behind() const override;
+};
+
+#endif /* WFALL_RESAMPLE_H */
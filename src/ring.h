@@ -0,0 +1,359 @@
+#ifndef WFALL_RING_H
+#define WFALL_RING_H
+
+#include <vector>
+#include <atomic>
+#include <bit>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+
+/**
+ * A lock-free single-producer/single-consumer ring buffer.
+ *
+ * The ring can hold several lanes that share the same read and write
+ * positions, so that a multichannel signal can be queued without
+ * interleaving it.
+ *
+ * The producer writes directly into the ring through write_ptr() and
+ * then publishes the items with commit(). The consumer reads through
+ * read_ptr() and releases the items with consume(). Both sides may
+ * block until there is data or space, or until the ring is closed.
+ */
+template <typename T>
+class SpscRing {
+    std::vector<T> _data;
+    std::size_t _capacity;
+    std::size_t _lanes;
+
+    alignas(64) std::atomic<std::size_t> _head = 0;
+    alignas(64) std::atomic<std::size_t> _tail = 0;
+    alignas(64) std::atomic<uint32_t> _events = 0;
+    std::atomic<bool> _closed = false;
+
+    void signal()
+    {
+        _events.fetch_add(1);
+        _events.notify_all();
+    }
+
+    template <typename Pred>
+    bool wait_until(Pred pred)
+    {
+        while (1) {
+            uint32_t events = _events.load();
+            if (pred()) {
+                return true;
+            }
+            if (_closed) {
+                return false;
+            }
+            _events.wait(events);
+        }
+    }
+
+public:
+    /**
+     * ctor.
+     *
+     * The capacity is rounded up to a power of two.
+     */
+    SpscRing(std::size_t capacity, std::size_t lanes = 1)
+        : _capacity(std::bit_ceil(capacity)), _lanes(lanes)
+    {
+        if (capacity == 0 || lanes == 0) {
+            throw std::invalid_argument("SpscRing needs a non-zero capacity and lane count");
+        }
+        _data.resize(_capacity * _lanes);
+    }
+
+    std::size_t capacity() const { return _capacity; }
+
+    std::size_t lanes() const { return _lanes; }
+
+    /**
+     * Returns the number of items that can be read.
+     */
+    std::size_t readable() const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns the number of items that can be written.
+     */
+    std::size_t writable() const
+    {
+        return _capacity - (_head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_acquire));
+    }
+
+    /**
+     * Returns the total number of items written since construction.
+     */
+    std::size_t written() const { return _head.load(std::memory_order_acquire); }
+
+    /**
+     * Returns the total number of items consumed since construction.
+     */
+    std::size_t consumed() const { return _tail.load(std::memory_order_acquire); }
+
+    /**
+     * Producer: returns a pointer to the next free slot of lane.
+     */
+    T* write_ptr(std::size_t lane)
+    {
+        return _data.data() + lane * _capacity + (_head.load(std::memory_order_relaxed) & (_capacity - 1));
+    }
+
+    /**
+     * Producer: the number of items that can be written contiguously
+     * at write_ptr().
+     */
+    std::size_t write_contiguous() const
+    {
+        std::size_t pos = _head.load(std::memory_order_relaxed) & (_capacity - 1);
+        return std::min(writable(), _capacity - pos);
+    }
+
+    /**
+     * Producer: publishes count items written at write_ptr().
+     */
+    void commit(std::size_t count)
+    {
+        _head.fetch_add(count, std::memory_order_release);
+        signal();
+    }
+
+    /**
+     * Consumer: returns a pointer to the oldest item of lane.
+     */
+    const T* read_ptr(std::size_t lane) const
+    {
+        return _data.data() + lane * _capacity + (_tail.load(std::memory_order_relaxed) & (_capacity - 1));
+    }
+
+    /**
+     * Consumer: the number of items that can be read contiguously at
+     * read_ptr().
+     */
+    std::size_t read_contiguous() const
+    {
+        std::size_t pos = _tail.load(std::memory_order_relaxed) & (_capacity - 1);
+        return std::min(readable(), _capacity - pos);
+    }
+
+    /**
+     * Consumer: releases the count oldest items.
+     */
+    void consume(std::size_t count)
+    {
+        _tail.fetch_add(count, std::memory_order_release);
+        signal();
+    }
+
+    /**
+     * Consumer: blocks until at least count items can be read.
+     *
+     * Returns false if the ring was closed first.
+     */
+    bool wait_readable(std::size_t count)
+    {
+        return wait_until([&] { return readable() >= count; });
+    }
+
+    /**
+     * Producer: blocks until at least count items can be written.
+     *
+     * Returns false if the ring was closed first.
+     */
+    bool wait_writable(std::size_t count)
+    {
+        return wait_until([&] { return writable() >= count; });
+    }
+
+    /**
+     * Wakes up and releases both sides. Items that are already in the
+     * ring can still be read.
+     */
+    void close()
+    {
+        _closed = true;
+        signal();
+    }
+
+    bool closed() const { return _closed; }
+};
+
+/**
+ * A lock-free ring of preallocated slots that are filled in sequence.
+ *
+ * Frame n of a sequence is stored in slot n % capacity(). A producer
+ * waits for the slot of its frame with acquire(), fills it in place and
+ * marks it ready with publish(). The consumer borrows the frames in
+ * sequence order with borrow() and hands each slot back with release().
+ * The slots are reused, so nothing is allocated once they have been
+ * filled the first time.
+ *
+ * Since every slot carries its own ready flag, frames may be published
+ * out of order by several producers, and the consumer still sees them
+ * in sequence.
+ */
+template <typename T>
+class SlotRing {
+    struct Slot {
+        T value;
+        std::atomic<bool> ready = false;
+    };
+
+    std::unique_ptr<Slot[]> _slots;
+    std::size_t _capacity;
+
+    /** All frames before _released have been handed back. */
+    alignas(64) std::atomic<uint64_t> _released = 0;
+    alignas(64) std::atomic<uint32_t> _events = 0;
+    std::atomic<bool> _closed = false;
+
+    void signal()
+    {
+        _events.fetch_add(1);
+        _events.notify_all();
+    }
+
+    Slot& slot(uint64_t seq) { return _slots[seq & (_capacity - 1)]; }
+
+public:
+    /**
+     * ctor.
+     *
+     * The capacity is rounded up to a power of two.
+     */
+    SlotRing(std::size_t capacity)
+        : _capacity(std::bit_ceil(capacity))
+    {
+        if (capacity == 0) {
+            throw std::invalid_argument("SlotRing needs a non-zero capacity");
+        }
+        _slots = std::make_unique<Slot[]>(_capacity);
+    }
+
+    std::size_t capacity() const { return _capacity; }
+
+    /**
+     * Returns the slot of frame seq, for preallocating the values before
+     * any producer is started, or for the producer to look back at the
+     * frames it has not had released yet.
+     */
+    T& at(uint64_t seq) { return slot(seq).value; }
+
+    /**
+     * Producer: blocks until the slot of frame seq is free and returns
+     * it.
+     *
+     * Returns nullptr if the ring was closed first.
+     */
+    T* acquire(uint64_t seq)
+    {
+        while (1) {
+            uint32_t events = _events.load();
+            if (_closed) {
+                return nullptr;
+            }
+            if (seq < _released.load(std::memory_order_acquire) + _capacity) {
+                return &slot(seq).value;
+            }
+            _events.wait(events);
+        }
+    }
+
+    /**
+     * Producer: marks frame seq as ready for the consumer.
+     */
+    void publish(uint64_t seq)
+    {
+        slot(seq).ready.store(true, std::memory_order_release);
+        signal();
+    }
+
+    /**
+     * Consumer: returns the next frame in sequence, or nullptr if it is
+     * not ready yet. The frame stays valid until release().
+     */
+    const T* borrow()
+    {
+        Slot& next = slot(_released.load(std::memory_order_relaxed));
+        if (!next.ready.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+
+        return &next.value;
+    }
+
+    /**
+     * Consumer: blocks until the next frame is ready and returns it.
+     *
+     * Returns nullptr if the ring was closed first.
+     */
+    const T* wait_borrow()
+    {
+        while (1) {
+            uint32_t events = _events.load();
+            if (const T* value = borrow()) {
+                return value;
+            }
+            if (_closed) {
+                return nullptr;
+            }
+            _events.wait(events);
+        }
+    }
+
+    /**
+     * Consumer: hands the borrowed frame back, so that its slot can be
+     * reused.
+     */
+    void release()
+    {
+        uint64_t seq = _released.load(std::memory_order_relaxed);
+        slot(seq).ready.store(false, std::memory_order_relaxed);
+        _released.store(seq + 1, std::memory_order_release);
+        signal();
+    }
+
+    /**
+     * Blocks until every frame before seq has been released.
+     *
+     * Returns false if the ring was closed first.
+     */
+    bool wait_released(uint64_t seq)
+    {
+        while (1) {
+            uint32_t events = _events.load();
+            if (_released.load(std::memory_order_acquire) >= seq) {
+                return true;
+            }
+            if (_closed) {
+                return false;
+            }
+            _events.wait(events);
+        }
+    }
+
+    /**
+     * Returns the number of frames that have been released.
+     */
+    uint64_t released() const { return _released.load(std::memory_order_acquire); }
+
+    /**
+     * Wakes up and releases all waiting producers and consumers.
+     */
+    void close()
+    {
+        _closed = true;
+        signal();
+    }
+
+    bool closed() const { return _closed; }
+};
+
+#endif /* WFALL_RING_H */
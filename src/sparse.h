@@ -0,0 +1,111 @@
+#ifndef WFALL_SPARSE_H
+#define WFALL_SPARSE_H
+
+#include <vector>
+#include <complex>
+#include <span>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * A sparse matrix in compressed sparse row (CSR) form.
+ *
+ * The nonzero entries of every row are stored one row after another,
+ * each with its column, so a matrix-vector product touches only the
+ * entries that are there. Built once, row by row, with push() and
+ * end_row(), and read-only after that.
+ *
+ * T is float or std::complex<float>.
+ */
+template <typename T>
+class CsrMatrix {
+    std::size_t _cols;
+    std::vector<uint32_t> _row_start{0};
+    std::vector<uint32_t> _col;
+    std::vector<T> _value;
+
+public:
+    explicit CsrMatrix(std::size_t cols = 0) : _cols(cols) {}
+
+    std::size_t rows() const { return _row_start.size() - 1; }
+    std::size_t cols() const { return _cols; }
+    std::size_t nonzeros() const { return _value.size(); }
+
+    /**
+     * Adds an entry to the row being built.
+     */
+    void push(std::size_t col, T value)
+    {
+        _col.push_back(col);
+        _value.push_back(value);
+    }
+
+    /**
+     * Finishes the row being built, which may be empty.
+     */
+    void end_row()
+    {
+        _row_start.push_back(_value.size());
+    }
+
+    std::span<const uint32_t> row_cols(std::size_t row) const
+    {
+        return std::span(_col).subspan(_row_start[row], _row_start[row + 1] - _row_start[row]);
+    }
+
+    std::span<const T> row_values(std::size_t row) const
+    {
+        return std::span(_value).subspan(_row_start[row], _row_start[row + 1] - _row_start[row]);
+    }
+
+    /**
+     * Returns the product of row and the vector x.
+     *
+     * The complex products are written out on the real and imaginary
+     * parts, so that the loop vectorizes without the checks for
+     * infinities of std::complex.
+     */
+    T dot(std::size_t row, const T* x) const
+    {
+        const uint32_t begin = _row_start[row];
+        const uint32_t end = _row_start[row + 1];
+        const uint32_t* col = _col.data();
+
+        if constexpr (std::is_same_v<T, float>) {
+            const float* v = _value.data();
+            float acc = 0.0f;
+            #pragma omp simd reduction(+ : acc)
+            for (uint32_t i = begin; i < end; i++) {
+                acc += v[i] * x[col[i]];
+            }
+            return acc;
+        } else {
+            auto v = reinterpret_cast<const float*>(_value.data());
+            auto xf = reinterpret_cast<const float*>(x);
+            float re = 0.0f;
+            float im = 0.0f;
+            #pragma omp simd reduction(+ : re, im)
+            for (uint32_t i = begin; i < end; i++) {
+                float vr = v[2 * i];
+                float vi = v[2 * i + 1];
+                float xr = xf[2 * col[i]];
+                float xi = xf[2 * col[i] + 1];
+                re += vr * xr - vi * xi;
+                im += vr * xi + vi * xr;
+            }
+            return T(re, im);
+        }
+    }
+
+    /**
+     * Computes y = A x, with x of cols() and y of rows() values.
+     */
+    void multiply(const T* x, T* y) const
+    {
+        for (std::size_t r = 0; r < rows(); r++) {
+            y[r] = dot(r, x);
+        }
+    }
+};
+
+#endif /* WFALL_SPARSE_H */
@@ -0,0 +1,102 @@
+#include "threadpool.h"
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+ThreadPool::ThreadPool(std::size_t threads)
+{
+    threads = std::max<std::size_t>(threads, 1);
+    for (std::size_t i = 0; i < threads; i++) {
+        _threads.emplace_back(&ThreadPool::worker_fn, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(_mutex);
+        _quit = true;
+    }
+    _cond.notify_all();
+
+    for (auto& thread : _threads) {
+        thread.join();
+    }
+}
+
+std::size_t ThreadPool::size() const
+{
+    return _threads.size();
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard lock(_mutex);
+        _tasks.push_back(std::move(task));
+    }
+    _cond.notify_one();
+}
+
+void ThreadPool::worker_fn()
+{
+    while (1) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(_mutex);
+            _cond.wait(lock, [this] { return _quit || !_tasks.empty(); });
+
+            if (_quit && _tasks.empty()) {
+                break;
+            }
+
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+void ThreadPool::parallel_for(std::size_t n, const std::function<void(std::size_t)>& fn)
+{
+    if (n == 0) {
+        return;
+    }
+
+    // Helpers may start after the loop is finished, so the shared state
+    // must outlive this call.
+    struct Loop {
+        std::atomic<std::size_t> next = 0;
+        std::atomic<std::size_t> done = 0;
+        std::size_t n;
+        std::function<void(std::size_t)> fn;
+    };
+
+    auto loop = std::make_shared<Loop>();
+    loop->n = n;
+    loop->fn = fn;
+
+    auto run = [](Loop& loop) {
+        std::size_t i;
+        while ((i = loop.next.fetch_add(1)) < loop.n) {
+            loop.fn(i);
+            if (loop.done.fetch_add(1) + 1 == loop.n) {
+                loop.done.notify_all();
+            }
+        }
+    };
+
+    std::size_t helpers = std::min(n - 1, size());
+    for (std::size_t i = 0; i < helpers; i++) {
+        submit([loop, run] { run(*loop); });
+    }
+
+    run(*loop);
+
+    std::size_t done;
+    while ((done = loop->done.load()) < n) {
+        loop->done.wait(done);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef WFALL_THREADPOOL_H
+#define WFALL_THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/**
+ * A fixed size pool of worker threads.
+ *
+ * Tasks are run in submission order by the first idle worker.
+ */
+class ThreadPool {
+    std::vector<std::thread> _threads;
+    std::deque<std::function<void()>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    bool _quit = false;
+
+    void worker_fn();
+
+public:
+    /**
+     * ctor.
+     *
+     * Starts the given number of worker threads, by default one per
+     * hardware thread.
+     */
+    explicit ThreadPool(std::size_t threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Returns the number of worker threads.
+     */
+    std::size_t size() const;
+
+    /**
+     * Queues a task to be run on one of the workers.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * Calls fn(i) for every i in [0, n) and waits for all calls to
+     * return.
+     *
+     * The calling thread takes part in the work, so parallel_for may be
+     * called from inside a task without deadlocking the pool.
+     */
+    void parallel_for(std::size_t n, const std::function<void(std::size_t)>& fn);
+};
+
+#endif /* WFALL_THREADPOOL_H */
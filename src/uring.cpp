@@ -0,0 +1,498 @@
+#include "uring.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <new>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+static int io_uring_setup(unsigned entries, io_uring_params* params)
+{
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args)
+{
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static unsigned load_acquire(unsigned* ptr)
+{
+    return std::atomic_ref<unsigned>(*ptr).load(std::memory_order_acquire);
+}
+
+static void store_release(unsigned* ptr, unsigned value)
+{
+    std::atomic_ref<unsigned>(*ptr).store(value, std::memory_order_release);
+}
+
+UringBuf::UringBuf(int fd, std::size_t chunk, unsigned depth)
+    : _fd(fd), _chunk(chunk)
+{
+    if (chunk == 0 || depth == 0) {
+        throw std::invalid_argument("UringBuf needs a non-zero chunk size and depth");
+    }
+
+    off_t pos = lseek(fd, 0, SEEK_CUR);
+    _seekable = pos != -1;
+    _offset = _seekable ? pos : 0;
+
+    // Page aligned buffers can be registered with the kernel.
+    _chunk = (chunk + 4095) / 4096 * 4096;
+    _memory = static_cast<char*>(std::aligned_alloc(4096, _chunk * depth));
+    if (_memory == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    _buffers.resize(depth);
+    for (std::size_t i = 0; i < depth; i++) {
+        _buffers[i].data = _memory + i * _chunk;
+    }
+
+    if (!setup_ring(depth)) {
+        teardown_ring();
+    }
+}
+
+UringBuf::~UringBuf()
+{
+    // The kernel may still write into the buffers.
+    while (_ring_fd >= 0 && _in_flight > 0) {
+        wait_completion();
+    }
+
+    teardown_ring();
+    std::free(_memory);
+}
+
+bool UringBuf::uring() const
+{
+    return _ring_fd >= 0;
+}
+
+bool UringBuf::setup_ring(unsigned depth)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    _ring_fd = io_uring_setup(depth, &params);
+    if (_ring_fd < 0) {
+        return false;
+    }
+
+    _cur_pos = params.features & IORING_FEAT_RW_CUR_POS;
+
+    _sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    _cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        _sq_size = _cq_size = std::max(_sq_size, _cq_size);
+    }
+
+    _sq_ptr = mmap(nullptr, _sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            _ring_fd, IORING_OFF_SQ_RING);
+    if (_sq_ptr == MAP_FAILED) {
+        _sq_ptr = nullptr;
+        return false;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        _cq_ptr = _sq_ptr;
+    } else {
+        _cq_ptr = mmap(nullptr, _cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                _ring_fd, IORING_OFF_CQ_RING);
+        if (_cq_ptr == MAP_FAILED) {
+            _cq_ptr = nullptr;
+            return false;
+        }
+    }
+
+    _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            _ring_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+    _sqes = static_cast<io_uring_sqe*>(sqes);
+
+    auto sq = static_cast<char*>(_sq_ptr);
+    _sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    _sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    _sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    _sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+    auto cq = static_cast<char*>(_cq_ptr);
+    _cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    _cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    _cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // Registered buffers save the kernel from mapping the pages on every
+    // read. This can fail if the locked memory limit is low, plain reads
+    // work too.
+    std::vector<iovec> iovecs(_buffers.size());
+    for (std::size_t i = 0; i < _buffers.size(); i++) {
+        iovecs[i].iov_base = _buffers[i].data;
+        iovecs[i].iov_len = _chunk;
+    }
+    _fixed = io_uring_register(_ring_fd, IORING_REGISTER_BUFFERS, iovecs.data(), iovecs.size()) == 0;
+
+    return true;
+}
+
+void UringBuf::teardown_ring()
+{
+    if (_sqes) {
+        munmap(_sqes, _sqes_size);
+        _sqes = nullptr;
+    }
+    if (_cq_ptr && _cq_ptr != _sq_ptr) {
+        munmap(_cq_ptr, _cq_size);
+    }
+    _cq_ptr = nullptr;
+    if (_sq_ptr) {
+        munmap(_sq_ptr, _sq_size);
+        _sq_ptr = nullptr;
+    }
+    if (_ring_fd >= 0) {
+        close(_ring_fd);
+        _ring_fd = -1;
+    }
+}
+
+void UringBuf::prepare_read(std::size_t idx, bool link)
+{
+    Buffer& buf = _buffers[idx];
+
+    unsigned tail = *_sq_tail;
+    unsigned slot = tail & *_sq_mask;
+    io_uring_sqe* sqe = &_sqes[slot];
+    std::memset(sqe, 0, sizeof(*sqe));
+
+    sqe->opcode = _fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = _fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf.data);
+    sqe->len = _chunk;
+    sqe->user_data = idx;
+    if (_fixed) {
+        sqe->buf_index = idx;
+    }
+
+    if (_seekable) {
+        buf.offset = _offset;
+        sqe->off = _offset;
+        _offset += _chunk;
+    } else {
+        sqe->off = _cur_pos ? uint64_t(-1) : 0;
+    }
+
+    if (link) {
+        sqe->flags |= IOSQE_IO_LINK;
+    }
+
+    _sq_array[slot] = slot;
+    store_release(_sq_tail, tail + 1);
+
+    buf.state = State::InFlight;
+    _order.push_back(idx);
+    _in_flight++;
+}
+
+void UringBuf::submit(unsigned count)
+{
+    while (count > 0) {
+        int ret = io_uring_enter(_ring_fd, count, 0, 0);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                reap();
+                continue;
+            }
+            throw std::runtime_error(std::string("io_uring_enter: ") + std::strerror(errno));
+        }
+        count -= ret;
+    }
+}
+
+void UringBuf::submit_free()
+{
+    if (_eof) {
+        return;
+    }
+
+    // Reads without offsets are only ordered within one linked chain, so
+    // a new chain is started once the previous one has completed.
+    if (!_seekable && _in_flight > 0) {
+        return;
+    }
+
+    std::vector<std::size_t> free;
+    for (std::size_t i = 0; i < _buffers.size(); i++) {
+        if (_buffers[i].state == State::Free && _current != i) {
+            free.push_back(i);
+        }
+    }
+
+    for (std::size_t i = 0; i < free.size(); i++) {
+        bool link = !_seekable && i + 1 < free.size();
+        prepare_read(free[i], link);
+    }
+
+    if (!free.empty()) {
+        submit(free.size());
+    }
+}
+
+void UringBuf::reap()
+{
+    unsigned head = *_cq_head;
+    unsigned tail = load_acquire(_cq_tail);
+
+    for (; head != tail; head++) {
+        io_uring_cqe* cqe = &_cqes[head & *_cq_mask];
+        Buffer& buf = _buffers[cqe->user_data];
+        buf.result = cqe->res;
+        buf.state = buf.state == State::Stale ? State::Free : State::Ready;
+        _in_flight--;
+    }
+
+    store_release(_cq_head, head);
+}
+
+void UringBuf::wait_completion()
+{
+    if (io_uring_enter(_ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+        throw std::runtime_error(std::string("io_uring_enter: ") + std::strerror(errno));
+    }
+    reap();
+}
+
+void UringBuf::drop(std::size_t idx)
+{
+    Buffer& buf = _buffers[idx];
+    buf.state = buf.state == State::InFlight ? State::Stale : State::Free;
+}
+
+void UringBuf::restart(int64_t offset)
+{
+    for (std::size_t idx : _order) {
+        drop(idx);
+    }
+    if (_current) {
+        drop(*_current);
+    }
+    _order.clear();
+    _current.reset();
+    _skip = 0;
+    _offset = offset;
+    _eof = false;
+    setg(nullptr, nullptr, nullptr);
+}
+
+bool UringBuf::seek_buffered(int64_t target)
+{
+    // The buffers in _order follow each other, and the ones in flight
+    // are taken to be full until they complete.
+    auto it = std::find_if(_order.begin(), _order.end(), [&](std::size_t idx) {
+        const Buffer& buf = _buffers[idx];
+        int64_t size = buf.state == State::Ready ? std::max(buf.result, 0) : _chunk;
+        return target >= buf.offset && target < buf.offset + size;
+    });
+    if (it == _order.end()) {
+        return false;
+    }
+
+    if (_current) {
+        drop(*_current);
+        _current.reset();
+    }
+    while (_order.begin() != it) {
+        drop(_order.front());
+        _order.pop_front();
+    }
+
+    // The buffer is taken by the next underflow, which may not have to
+    // wait for it.
+    _skip = target - _buffers[_order.front()].offset;
+    setg(nullptr, nullptr, nullptr);
+    submit_free();
+
+    return true;
+}
+
+UringBuf::int_type UringBuf::underflow_read()
+{
+    ssize_t n;
+    do {
+        n = ::read(_fd, _buffers[0].data, _chunk);
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0) {
+        return traits_type::eof();
+    }
+
+    _buffers[0].offset = _offset;
+    _offset += n;
+    setg(_buffers[0].data, _buffers[0].data, _buffers[0].data + n);
+
+    return traits_type::to_int_type(*gptr());
+}
+
+UringBuf::int_type UringBuf::underflow()
+{
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    if (_ring_fd < 0) {
+        return underflow_read();
+    }
+
+    if (_current) {
+        _buffers[*_current].state = State::Free;
+        _current.reset();
+    }
+
+    while (1) {
+        submit_free();
+
+        if (_order.empty()) {
+            // After a seek every buffer may still be busy with a read that
+            // is no longer wanted.
+            if (!_eof && _in_flight > 0) {
+                wait_completion();
+                continue;
+            }
+            return traits_type::eof();
+        }
+
+        std::size_t idx = _order.front();
+        Buffer& buf = _buffers[idx];
+        while (buf.state == State::InFlight) {
+            wait_completion();
+        }
+        _order.pop_front();
+        const std::size_t skip = std::exchange(_skip, 0);
+
+        if (buf.result == -ECANCELED || buf.result == -EAGAIN || buf.result == -EINTR) {
+            // A short read ended the chain, or the read was interrupted.
+            // Nothing was read, so the buffer is simply read again.
+            buf.state = State::Free;
+            if (_seekable) {
+                restart(buf.offset + skip);
+            }
+            continue;
+        }
+
+        if (buf.result <= 0) {
+            // The position stays where the data ended, not after the
+            // reads that were submitted past it.
+            buf.state = State::Free;
+            restart(buf.offset + skip);
+            _eof = true;
+            return traits_type::eof();
+        }
+
+        if (_seekable && std::size_t(buf.result) < _chunk) {
+            // Only expected at the end of a file, but the following
+            // reads started further on, so they must be redone.
+            for (std::size_t i : _order) {
+                drop(i);
+            }
+            _order.clear();
+            _offset = buf.offset + std::max<int64_t>(buf.result, skip);
+        }
+
+        // A seek went past what the read returned.
+        if (skip >= std::size_t(buf.result)) {
+            buf.state = State::Free;
+            continue;
+        }
+
+        _current = idx;
+        setg(buf.data, buf.data + skip, buf.data + buf.result);
+
+        submit_free();
+
+        return traits_type::to_int_type(*gptr());
+    }
+}
+
+UringBuf::pos_type UringBuf::seekoff(off_type off, std::ios_base::seekdir dir,
+        std::ios_base::openmode which)
+{
+    if (!_seekable || !(which & std::ios_base::in)) {
+        return pos_type(off_type(-1));
+    }
+
+    // The position of the next byte that would be returned.
+    int64_t pos;
+    if (gptr() != nullptr && (_current || _ring_fd < 0)) {
+        const Buffer& buf = _ring_fd < 0 ? _buffers[0] : _buffers[*_current];
+        pos = buf.offset + (gptr() - eback());
+    } else if (!_order.empty()) {
+        pos = _buffers[_order.front()].offset + _skip;
+    } else {
+        pos = _offset;
+    }
+
+    int64_t target;
+    if (dir == std::ios_base::beg) {
+        target = off;
+    } else if (dir == std::ios_base::cur) {
+        target = pos + off;
+    } else {
+        off_t end = lseek(_fd, 0, SEEK_END);
+        if (end < 0) {
+            return pos_type(off_type(-1));
+        }
+        target = end + off;
+    }
+
+    if (target < 0) {
+        return pos_type(off_type(-1));
+    }
+
+    if (target == pos) {
+        return pos_type(target);
+    }
+
+    // Within the current buffer only the get pointer moves.
+    if (gptr() != nullptr && (_current || _ring_fd < 0)) {
+        const Buffer& buf = _ring_fd < 0 ? _buffers[0] : _buffers[*_current];
+        if (target >= buf.offset && target < buf.offset + (egptr() - eback())) {
+            setg(eback(), eback() + (target - buf.offset), egptr());
+            return pos_type(target);
+        }
+    }
+
+    if (_ring_fd < 0) {
+        if (lseek(_fd, target, SEEK_SET) < 0) {
+            return pos_type(off_type(-1));
+        }
+        _offset = target;
+        setg(nullptr, nullptr, nullptr);
+    } else if (!seek_buffered(target)) {
+        restart(target);
+    }
+
+    return pos_type(target);
+}
+
+UringBuf::pos_type UringBuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
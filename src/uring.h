@@ -0,0 +1,133 @@
+#ifndef WFALL_URING_H
+#define WFALL_URING_H
+
+#include <streambuf>
+#include <vector>
+#include <deque>
+#include <optional>
+#include <cstdint>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/**
+ * A stream buffer that reads a file descriptor with io_uring.
+ *
+ * Several chunk sized reads are kept in flight into registered buffers,
+ * so the kernel fills the next buffers while the current one is being
+ * decoded. Use it as the buffer of an std::istream to feed a PcmStream.
+ *
+ * Regular files are read at explicit offsets, with all reads running in
+ * parallel, and support seeking. A seek into the data that is ready or
+ * on its way keeps the reads after it going, and no seek waits for the
+ * reads it makes useless. Pipes and sockets have no offsets, so their
+ * reads are linked to complete in order.
+ *
+ * If io_uring is not available, UringBuf falls back to plain read(2).
+ */
+class UringBuf : public std::streambuf {
+    enum class State {
+        Free,
+        InFlight,
+        Ready,
+        /** In flight, but the data is no longer wanted. */
+        Stale,
+    };
+
+    struct Buffer {
+        char* data;
+        int64_t offset = 0;
+        int result = 0;
+        State state = State::Free;
+    };
+
+    int _fd;
+    std::size_t _chunk;
+    char* _memory = nullptr;
+    std::vector<Buffer> _buffers;
+    /** Buffers that are in flight or ready, in stream order. */
+    std::deque<std::size_t> _order;
+    std::optional<std::size_t> _current;
+    /** Bytes to skip in the first buffer of _order, after a seek into it. */
+    std::size_t _skip = 0;
+    bool _seekable;
+    int64_t _offset = 0;
+    bool _eof = false;
+
+    int _ring_fd = -1;
+    bool _fixed = false;
+    bool _cur_pos = false;
+    unsigned _in_flight = 0;
+
+    void* _sq_ptr = nullptr;
+    std::size_t _sq_size = 0;
+    void* _cq_ptr = nullptr;
+    std::size_t _cq_size = 0;
+    io_uring_sqe* _sqes = nullptr;
+    std::size_t _sqes_size = 0;
+
+    unsigned* _sq_head;
+    unsigned* _sq_tail;
+    unsigned* _sq_mask;
+    unsigned* _sq_array;
+    unsigned* _cq_head;
+    unsigned* _cq_tail;
+    unsigned* _cq_mask;
+    io_uring_cqe* _cqes;
+
+    bool setup_ring(unsigned depth);
+    void teardown_ring();
+
+    void prepare_read(std::size_t idx, bool link);
+    void submit_free();
+    void submit(unsigned count);
+    void reap();
+    void wait_completion();
+
+    /**
+     * Forgets the data of a buffer. If its read is still in flight, the
+     * buffer is freed when the read completes.
+     */
+    void drop(std::size_t idx);
+
+    /**
+     * Forgets all buffered data, so that reading can continue at offset.
+     * The reads in flight are not waited for.
+     */
+    void restart(int64_t offset);
+
+    /**
+     * Moves the read position to target if it is in one of the buffers
+     * that are ready or in flight. Returns false if it is not.
+     */
+    bool seek_buffered(int64_t target);
+
+    int_type underflow_read();
+
+protected:
+    int_type underflow() override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+            std::ios_base::openmode which = std::ios_base::in) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) override;
+
+public:
+    /**
+     * ctor.
+     *
+     * Reads fd, which is not closed by UringBuf, in chunks of the given
+     * size with up to depth reads in flight.
+     */
+    UringBuf(int fd, std::size_t chunk = 1 << 16, unsigned depth = 4);
+    ~UringBuf();
+
+    UringBuf(const UringBuf&) = delete;
+    UringBuf& operator=(const UringBuf&) = delete;
+
+    /**
+     * Returns true if io_uring is used, false if it fell back to
+     * read(2).
+     */
+    bool uring() const;
+};
+
+#endif /* WFALL_URING_H */
@@ -2,6 +2,13 @@
 #include <fstream>
 #include <vector>
 #include <cmath>
+#include <memory>
+#include <span>
+#include <bit>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <SDL.h>
 #include <glad/glad.h>
@@ -11,11 +18,24 @@
 #include "affine2d.h"
 #include "fftseq.h"
 #include "cmap.h"
+#include "options.h"
+#include "buffered.h"
+#include "ddc.h"
+#include "halfband.h"
+#include "resample.h"
+#include "convolve.h"
+#include "uring.h"
+#include "net.h"
+#include "feed.h"
+#include "batch.h"
+#include "pipeline.h"
 
 static const std::size_t WIN_HEIGHT = 800;
 static const std::size_t WIN_WIDTH = 1280;
-static const std::size_t FFT_SIZE = 2048;
 static const float SPECTRUM_HEIGHT = 0.2f;
+static const std::size_t MAX_HIST_LEN = 1024;
+static const std::size_t MIN_FFT_SIZE = 16;
+static const std::size_t MAX_FFT_SIZE = 1 << 20;
 static const std::string cmap_path = "res/cmap/turbo.csv";
 
 void GLAPIENTRY
@@ -25,54 +45,109 @@ message_callback(GLenum source, GLenum type, GLuint id, GLenum severity,
     std::cerr << "type = " << type << ", severity = " << severity << ", msg = " << msg << std::endl;
 }
 
-std::vector<float> fft_db(const std::vector<float>& fft)
+std::vector<float> power_db(const std::vector<float>& power)
 {
-    std::vector<float> out(fft.size());
+    std::vector<float> out(power.size());
 
-    for (std::size_t i = 0; i < fft.size(); i++) {
-        out[i] = 20.0f * std::log10(fft[i]);
+    for (std::size_t i = 0; i < power.size(); i++) {
+        out[i] = 10.0f * std::log10(power[i]);
     }
 
     return out;
 }
 
-std::vector<float> fft_pos_abs(const std::vector<std::complex<float>>& fft)
+void print_overruns(const OverrunStats& stats, std::size_t capacity, std::size_t frames_skipped)
 {
-    std::vector<float> out(fft.size() / 2);
-    float norm = 2.0f / fft.size();
-    for (std::size_t i = 0; i < out.size(); i++) {
-        out[i] = std::abs(fft[i]) * norm;
-    }
+    std::cerr << "Overrun: " << stats.samples_dropped << " samples dropped, "
+              << frames_skipped << " frames skipped, "
+              << stats.stalls << " stalls, peak buffer "
+              << (100 * stats.high_water / capacity) << "%" << std::endl;
+}
 
-    return out;
+void print_packet_loss(const UdpStats& stats)
+{
+    std::cerr << "Packet loss: " << stats.lost << " lost, "
+              << stats.late << " late, "
+              << stats.truncated << " truncated of "
+              << stats.datagrams << " datagrams" << std::endl;
 }
 
-std::vector<float> fft_shift_abs(const std::vector<std::complex<float>>& fft)
+/**
+ * Prints the throughput of every stage of a pipeline since the previous
+ * report, and the share of that time it was busy rather than waiting for
+ * the stages around it. The busiest stage limits the pipeline.
+ */
+void print_stages(const std::vector<StageStats>& stats, const std::vector<StageStats>& previous)
 {
-    std::vector<float> out(fft.size());
-    std::size_t half = out.size() / 2;
-    float norm = 1.0f / fft.size();
-    for (std::size_t i = 0; i < out.size(); i++) {
-        int shift = (i < half) ? half : -half;
-        out[i] = std::abs(fft[i + shift]) * norm;
-    }
+    std::cerr << "Stages:";
+    for (std::size_t i = 0; i < stats.size(); i++) {
+        StageStats delta = stats[i];
+        if (i < previous.size()) {
+            delta.items_in -= previous[i].items_in;
+            delta.items_out -= previous[i].items_out;
+            delta.busy -= previous[i].busy;
+            delta.elapsed -= previous[i].elapsed;
+        }
+        if (delta.elapsed <= 0.0) {
+            continue;
+        }
 
-    return out;
+        std::cerr << (i == 0 ? " " : ", ") << delta.name;
+        if (delta.inputs > 0) {
+            std::cerr << " in " << std::lround(delta.items_in / delta.elapsed / 1000.0) << " kS/s";
+        }
+        if (delta.outputs > 0) {
+            std::cerr << " out " << std::lround(delta.items_out / delta.elapsed / 1000.0) << " kS/s";
+        }
+        std::cerr << " " << std::lround(100.0 * delta.busy / delta.elapsed) << "% busy";
+    }
+    std::cerr << std::endl;
 }
 
-void gen_fft_mipmap(const std::vector<std::complex<float>>& fft,
-        std::size_t idx, bool negative = false)
+/**
+ * Latency of the frames displayed since the last report, in seconds.
+ */
+struct LatencyStats {
+    std::size_t frames = 0;
+    /** From the arrival of the newest sample until the FFT started. */
+    double wait = 0.0;
+    /** Computing the FFTs. */
+    double compute = 0.0;
+    /** From the end of the computation until the frame was drawn. */
+    double handoff = 0.0;
+    /** From the arrival of the newest sample until it was drawn. */
+    double total_max = 0.0;
+
+    void add(const FrameInfo& info, Stream::Clock::time_point drawn)
+    {
+        using Seconds = std::chrono::duration<double>;
+        frames++;
+        wait += Seconds(info.compute_start - info.last_arrival).count();
+        compute += Seconds(info.compute_end - info.compute_start).count();
+        handoff += Seconds(drawn - info.compute_end).count();
+        total_max = std::max(total_max, Seconds(drawn - info.last_arrival).count());
+    }
+};
+
+void print_latency(const LatencyStats& stats)
 {
-    std::vector<float> mipmap;
-    if (negative) {
-        mipmap = fft_shift_abs(fft);
-    } else {
-        mipmap = fft_pos_abs(fft);
+    if (stats.frames == 0) {
+        return;
     }
 
+    double ms = 1000.0 / stats.frames;
+    std::cerr << "Latency: wait " << stats.wait * ms << " ms, compute "
+              << stats.compute * ms << " ms, handoff " << stats.handoff * ms
+              << " ms, worst total " << stats.total_max * 1000.0 << " ms" << std::endl;
+}
+
+void gen_fft_mipmap(std::span<const float> power, std::size_t idx)
+{
+    std::vector<float> mipmap(power.begin(), power.end());
+
     int level = 0;
     do {
-        std::vector<float> tex_line = fft_db(mipmap);
+        std::vector<float> tex_line = power_db(mipmap);
         glTexSubImage2D(GL_TEXTURE_1D_ARRAY, level, 0, idx, tex_line.size(), 1,
                 GL_RED, GL_FLOAT, tex_line.data());
 
@@ -85,8 +160,324 @@ void gen_fft_mipmap(const std::vector<std::complex<float>>& fft,
     } while (mipmap.size() > 1);
 }
 
-int main()
+/**
+ * Uploads a row of power to a texture without mipmaps.
+ */
+void upload_row(std::span<const float> power, std::size_t idx)
+{
+    std::vector<float> tex_line = power_db(std::vector<float>(power.begin(), power.end()));
+    glTexSubImage2D(GL_TEXTURE_1D_ARRAY, 0, 0, idx, tex_line.size(), 1,
+            GL_RED, GL_FLOAT, tex_line.data());
+}
+
+/**
+ * Resamples a row of power in dB to a new number of bins, averaging the
+ * power of the bins that a new bin covers.
+ */
+void rescale_row(std::span<const float> from, std::span<float> to)
+{
+    const double ratio = double(from.size()) / to.size();
+    for (std::size_t i = 0; i < to.size(); i++) {
+        double lo = i * ratio;
+        double hi = lo + ratio;
+        double sum = 0.0;
+        for (std::size_t j = std::size_t(lo); j < from.size() && j < hi; j++) {
+            double overlap = std::min<double>(hi, j + 1) - std::max<double>(lo, j);
+            sum += overlap * std::pow(10.0, from[j] / 10.0);
+        }
+        to[i] = 10.0f * std::log10(sum / ratio);
+    }
+}
+
+/**
+ * Changes the width of the waterfall texture to bins, keeping the rows
+ * already drawn.
+ */
+void rescale_waterfall(std::size_t from, std::size_t bins, std::size_t rows)
+{
+    std::vector<float> old_rows(from * rows);
+    glGetTexImage(GL_TEXTURE_1D_ARRAY, 0, GL_RED, GL_FLOAT, old_rows.data());
+
+    std::span<const float> old_span(old_rows);
+    std::vector<float> new_rows(bins * rows);
+    for (std::size_t r = 0; r < rows; r++) {
+        rescale_row(old_span.subspan(r * from, from), std::span(new_rows).subspan(r * bins, bins));
+    }
+
+    glTexImage2D(GL_TEXTURE_1D_ARRAY, 0, GL_R32F, bins, rows, 0, GL_RED, GL_FLOAT, new_rows.data());
+    glGenerateMipmap(GL_TEXTURE_1D_ARRAY);
+}
+
+/**
+ * One FFT view of the input, with its own waterfall texture. Every lane
+ * of the view gets a spectrum and a waterfall.
+ */
+struct Panel {
+    std::unique_ptr<FftSeq> fft_seq;
+    GLuint texture;
+    std::size_t bins;
+    std::size_t line = 0;
+    float wrap_pos = 0.0f;
+    float fft_rate;
+    std::size_t window_idx;
+    /**
+     * False if the spectra are rebinned to the width of the window, so
+     * that the texture needs no mipmaps.
+     */
+    bool mipmap = true;
+};
+
+/**
+ * Returns the dB range shown for a view with the given FFT size.
+ *
+ * A density is lower than the power in a bin by the bin bandwidth, so
+ * the default range of a PSD view moves with its FFT size.
+ */
+std::pair<float, float> db_range(const Options& opts, float rate, std::size_t fft_size)
 {
+    auto [lo, hi] = opts.db_range.value_or(std::pair(-100.0f, -20.0f));
+    if (opts.psd && !opts.db_range) {
+        float bandwidth_db = 10.0f * std::log10(rate / fft_size);
+        lo -= bandwidth_db;
+        hi -= bandwidth_db;
+    }
+
+    return {lo, hi};
+}
+
+/**
+ * Applies the FFT options that all views share, and prints the
+ * resulting setup.
+ */
+void setup_fft_seq(FftSeq& fft_seq, const Options& opts, float rate, float fft_rate,
+        bool two_sided, const CqtSpec& cqt, const AxisSpec& axis)
+{
+    fft_seq.pfb(opts.pfb_taps);
+    fft_seq.two_sided(two_sided);
+    fft_seq.cqt(cqt);
+    fft_seq.axis(axis);
+    if (opts.welch) {
+        fft_seq.average(AverageMode::Linear, opts.welch);
+        fft_seq.spacing(-int(fft_seq.frame_size() / 2));
+    } else {
+        fft_seq.average(opts.average, opts.average_count, opts.alpha);
+        fft_seq.optimal_spacing(rate, fft_rate);
+    }
+    if (opts.psd) {
+        fft_seq.psd(rate);
+    }
+
+    std::cerr << "FFT size " << fft_seq.fft_size() << ", spacing: " << fft_seq.spacing() << std::endl;
+    if (opts.welch) {
+        float row_rate = 2.0f * rate / (fft_seq.frame_size() * opts.welch);
+        std::cerr << "Welch: " << opts.welch << " segments per row, "
+                  << row_rate << " rows per second" << std::endl;
+    }
+}
+
+/**
+ * Writes the spectrogram of the whole input to opts.output, without a
+ * window.
+ *
+ * The FFTs are computed on every core by default, while the input is read
+ * and the rows are written on threads of their own, so that the disk
+ * rather than the computation limits the throughput.
+ */
+int run_batch(const Options& opts, Stream& source, float rate, bool two_sided,
+        const CqtSpec& cqt, const AxisSpec& axis, const Pipeline* pipeline)
+{
+    std::size_t fft_size = opts.fft_size;
+    if (cqt.min_freq > 0.0f) {
+        fft_size = std::max(fft_size, cqt_fft_size(cqt));
+    }
+
+    FftSeq fft_seq(source, fft_size, opts.window);
+    fft_seq.workers(opts.fft_threads.value_or(std::max(1u, std::thread::hardware_concurrency())));
+    setup_fft_seq(fft_seq, opts, rate, opts.fft_rate, two_sided, cqt, axis);
+
+    SpectrogramWriter writer(opts.output, output_format(opts.output), fft_seq.lanes(),
+            fft_seq.bins());
+
+    auto start = Stream::Clock::now();
+    fft_seq.start();
+    while (const Frame* frame = fft_seq.wait_next()) {
+        writer.write(*frame);
+        fft_seq.release();
+    }
+    writer.finish();
+
+    std::chrono::duration<double> elapsed = Stream::Clock::now() - start;
+    std::cerr << "Wrote " << writer.rows() << " rows of " << fft_seq.bins() << " bins to "
+              << opts.output << " in " << elapsed.count() << " s" << std::endl;
+    if (pipeline) {
+        print_stages(pipeline->stats(), {});
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    Options opts;
+    std::ifstream file;
+    std::unique_ptr<UringBuf> uring_buf;
+    std::unique_ptr<std::istream> uring_in;
+    std::unique_ptr<RtlTcpBuf> rtl_buf;
+    std::unique_ptr<UdpBuf> udp_buf;
+    std::unique_ptr<std::istream> net_in;
+    std::unique_ptr<Stream> stream;
+    std::unique_ptr<BufferedStream> buffered;
+    std::unique_ptr<Pipeline> pipeline;
+    std::unique_ptr<StreamChain> chain;
+    Stream* source;
+    float rate;
+    try {
+        opts = parse_options(argc, argv);
+        if (opts.help) {
+            print_usage(std::cout, argv[0]);
+            return 0;
+        }
+
+        std::istream* in = &std::cin;
+        if (opts.uring) {
+            int fd = STDIN_FILENO;
+            if (!opts.input.empty()) {
+                fd = open(opts.input.c_str(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0) {
+                    throw std::runtime_error("Could not open " + opts.input + " for reading.");
+                }
+            }
+
+            uring_buf = std::make_unique<UringBuf>(fd, 1 << 16, opts.uring_depth);
+            uring_in = std::make_unique<std::istream>(uring_buf.get());
+            in = uring_in.get();
+            if (!uring_buf->uring()) {
+                std::cerr << "io_uring is not available, falling back to read(2)" << std::endl;
+            }
+        } else if (!opts.rtl_tcp.empty()) {
+            rtl_buf = std::make_unique<RtlTcpBuf>(opts.rtl_tcp);
+            rtl_buf->command(RtlCommand::SampleRate, static_cast<uint32_t>(opts.rate));
+            if (opts.rtl_freq) {
+                rtl_buf->command(RtlCommand::Frequency, *opts.rtl_freq);
+            }
+            rtl_buf->gain(opts.rtl_gain);
+            net_in = std::make_unique<std::istream>(rtl_buf.get());
+            in = net_in.get();
+        } else if (!opts.udp.empty()) {
+            udp_buf = std::make_unique<UdpBuf>(opts.udp, opts.udp_seq);
+            net_in = std::make_unique<std::istream>(udp_buf.get());
+            in = net_in.get();
+        } else if (!opts.input.empty()) {
+            file.open(opts.input, std::ios::binary);
+            if (!file) {
+                throw std::runtime_error("Could not open " + opts.input + " for reading.");
+            }
+            in = &file;
+        }
+
+        stream = make_pcm_stream(*in, opts.format);
+        source = stream.get();
+        rate = opts.rate;
+
+        // Drain live input on a thread of its own, so that the upstream
+        // producer is not held up while FFTs are computed or rendered.
+        // Files are read directly, so that skipped input can be seeked
+        // past, and so is all input of the batch mode, which waits for
+        // every sample.
+        if (opts.input.empty() && opts.output.empty()) {
+            std::size_t chunk = std::clamp<std::size_t>(std::bit_floor(std::size_t(opts.rate / 100)), 256, 65536);
+            std::size_t capacity = std::max<std::size_t>(opts.rate * opts.buffer, 4 * opts.fft_size * opts.pfb_taps);
+            buffered = std::make_unique<BufferedStream>(*stream, capacity, chunk);
+            buffered->policy(opts.drop);
+            source = buffered.get();
+        }
+
+        // With --stage-threads the input and every stage run on threads
+        // of their own and hand blocks of samples to the next through
+        // queues. Otherwise the FFTs pull the samples through the chain.
+        if (opts.stage_threads) {
+            std::size_t chunk = std::clamp<std::size_t>(std::bit_floor(std::size_t(opts.rate / 100)), 256, 65536);
+            pipeline = std::make_unique<Pipeline>();
+            chain = std::make_unique<StreamChain>(*source, *pipeline, chunk, 8 * chunk);
+        } else {
+            chain = std::make_unique<StreamChain>(*source);
+        }
+
+        if (!opts.fir.empty()) {
+            auto taps = read_taps(opts.fir);
+            chain->add<ConvolveStream>("fir", taps, opts.fir_block);
+        }
+
+        if (opts.ddc) {
+            chain->add<DdcStream>("ddc", rate, *opts.ddc, opts.ddc_decim);
+            rate /= opts.ddc_decim;
+        }
+
+        if (opts.halfband > 0) {
+            rate /= chain->add<HalfbandStream>("halfband", opts.halfband).decimation();
+        }
+
+        if (opts.resample) {
+            rate = chain->add<ResampleStream>("resample", rate, *opts.resample).out_rate(rate);
+        }
+
+        source = &chain->end();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        print_usage(std::cerr, argv[0]);
+        return 1;
+    }
+
+    if (buffered) {
+        buffered->start();
+    }
+    if (pipeline) {
+        pipeline->start();
+    }
+
+    // Complex input has a meaningful negative half of the spectrum.
+    const bool two_sided = opts.format.mode == ChannelMode::Iq || opts.ddc;
+
+    // The lowest frequency of the constant-Q transform sets the smallest
+    // FFT size that holds all of its bins.
+    CqtSpec cqt;
+    std::size_t min_fft_size = MIN_FFT_SIZE;
+    if (opts.cqt_freq) {
+        cqt = {*opts.cqt_freq / rate, opts.cqt_bins_per_octave};
+        if (cqt.min_freq >= 0.5f) {
+            std::cerr << "The constant-Q transform must start below half the sample rate." << std::endl;
+            return 1;
+        }
+        min_fft_size = std::max(min_fft_size, cqt_fft_size(cqt));
+        std::cerr << "Constant-Q: " << cqt_bins(cqt, min_fft_size) << " bins, "
+                  << cqt.bins_per_octave << " per octave" << std::endl;
+    }
+
+    // A rebinned axis has one bin per pixel.
+    AxisSpec axis;
+    if (opts.axis) {
+        axis = *opts.axis;
+        axis.width = WIN_WIDTH;
+        axis.rate = rate;
+        try {
+            check_axis(axis, two_sided);
+        } catch (const std::invalid_argument& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        std::cerr << "Axis: " << axis_name(axis) << ", " << axis_freq(axis, two_sided, 0.0)
+                  << " to " << axis_freq(axis, two_sided, 1.0) << " Hz" << std::endl;
+    }
+
+    if (!opts.output.empty()) {
+        try {
+            return run_batch(opts, *source, rate, two_sided, cqt, axis, pipeline.get());
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
     if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
         std::cerr << "SDL could not initialize. Error:"
                   << std::endl
@@ -167,23 +558,16 @@ int main()
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*) (2 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    glActiveTexture(GL_TEXTURE0);
-
-    GLuint texture;
-    glGenTextures(1, &texture);
-
-    glBindTexture(GL_TEXTURE_1D_ARRAY, texture);
-
-    glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    float border_color[4] = {-200.f, 0.0f, 0.0f, 0.0f};
-    glTexParameterfv(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_BORDER_COLOR, border_color);
-
-    std::vector<float> wfall_init(FFT_SIZE * 1024, -250.0f);
-    glTexImage2D(GL_TEXTURE_1D_ARRAY, 0, GL_R32F, FFT_SIZE, 1024, 0, GL_RED, GL_FLOAT, wfall_init.data());
-    glGenerateMipmap(GL_TEXTURE_1D_ARRAY);
+    // Each lane of the stream gets hist_len layers of the texture array
+    // of every view for its waterfall history.
+    const std::size_t lanes = stream->lanes();
+    GLint max_layers;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+    const std::size_t hist_len = std::min(MAX_HIST_LEN, std::bit_floor(max_layers / lanes));
+    if (hist_len == 0) {
+        std::cerr << "Too many channels for the waterfall texture." << std::endl;
+        exit(1);
+    }
 
     glActiveTexture(GL_TEXTURE0 + 1);
 
@@ -203,37 +587,123 @@ int main()
 
     glActiveTexture(GL_TEXTURE0);
 
-    std::size_t line = 0;
+    // The first view is the one of the FFT options, followed by those
+    // added with --view.
+    std::vector<ViewOptions> views{{opts.fft_size, opts.fft_rate, opts.window}};
+    views.insert(views.end(), opts.views.begin(), opts.views.end());
+    if (opts.cqt_freq) {
+        for (ViewOptions& view : views) {
+            view.fft_size = std::max(view.fft_size, min_fft_size);
+        }
+    }
+
+    // The window functions that W cycles through, and the ones given on
+    // the command line.
+    std::vector<WindowSpec> windows{
+        {WindowType::Blackman},
+        {WindowType::Hann},
+        {WindowType::BlackmanHarris},
+        {WindowType::FlatTop},
+        {WindowType::Kaiser, 8.6f},
+        {WindowType::Dpss, 3.0f},
+        {WindowType::Rectangular},
+    };
+    for (const ViewOptions& view : views) {
+        if (std::find(windows.begin(), windows.end(), view.window) == windows.end()) {
+            windows.push_back(view.window);
+        }
+    }
+
+    // The views share one history of the input, which is read once for
+    // all of them.
+    SampleFeed feed(*source);
+    std::vector<Panel> panels;
+    std::size_t selected = 0;
+
+    for (const ViewOptions& view : views) {
+        Panel panel;
+        panel.bins = two_sided ? view.fft_size : view.fft_size / 2;
+        if (opts.cqt_freq) {
+            panel.bins = cqt_bins(cqt, view.fft_size);
+        }
+        if (opts.axis) {
+            panel.bins = axis.width;
+            panel.mipmap = false;
+        }
+        panel.fft_rate = view.fft_rate;
+        panel.window_idx = std::find(windows.begin(), windows.end(), view.window) - windows.begin();
+
+        // Tables for the other windows are made now rather than when one
+        // is picked. Constant-Q kernels take too long to make for all of
+        // them up front.
+        for (const WindowSpec& window : windows) {
+            if (!opts.cqt_freq) {
+                window_table(window, view.fft_size, opts.pfb_taps);
+            }
+        }
 
-    PcmStream<int16_t> stream(std::cin);
-    stream.channels(2);
-    stream.mix();
+        glGenTextures(1, &panel.texture);
+        glBindTexture(GL_TEXTURE_1D_ARRAY, panel.texture);
 
-    FftSeq fft_seq(stream, FFT_SIZE * 2, blackman);
-    fft_seq.optimal_spacing(44100, 12);
+        glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                panel.mipmap ? GL_NEAREST_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    fft_seq.start();
+        glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        float border_color[4] = {-200.f, 0.0f, 0.0f, 0.0f};
+        glTexParameterfv(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_BORDER_COLOR, border_color);
 
-    std::cout << "FFT spacing: " << fft_seq.spacing() << std::endl;
+        std::vector<float> wfall_init(panel.bins * hist_len * lanes, -250.0f);
+        glTexImage2D(GL_TEXTURE_1D_ARRAY, 0, GL_R32F, panel.bins, hist_len * lanes, 0,
+                GL_RED, GL_FLOAT, wfall_init.data());
+        glGenerateMipmap(GL_TEXTURE_1D_ARRAY);
 
-    spectrum_shader.use();
+        panel.fft_seq = std::make_unique<FftSeq>(feed, view.fft_size, view.window);
+        FftSeq& fft_seq = *panel.fft_seq;
+        fft_seq.workers(opts.fft_threads.value_or(1));
+        setup_fft_seq(fft_seq, opts, rate, panel.fft_rate, two_sided, cqt, axis);
+        fft_seq.start();
 
-    glUniform1i(spectrum_shader["wfall"], 0);
+        panels.push_back(std::move(panel));
+    }
+
+    feed.start();
 
-    auto spectrum_transform = translate(0.0f, 1.0f - SPECTRUM_HEIGHT) * scale(1.0f, SPECTRUM_HEIGHT);
+    // Every lane of every view is a row of the window.
+    const std::size_t rows = panels.size() * lanes;
 
-    glUniformMatrix3fv(spectrum_shader["transform"], 1, GL_TRUE, spectrum_transform.data());
+    spectrum_shader.use();
+
+    glUniform1i(spectrum_shader["wfall"], 0);
     glUniform1f(spectrum_shader["width"], WIN_WIDTH);
 
     waterfall_shader.use();
-    auto waterfall_transform = translate(0.0f, -SPECTRUM_HEIGHT) * scale(1.0f, 1.0f - SPECTRUM_HEIGHT);
-
-    glUniformMatrix3fv(waterfall_shader["transform"], 1, GL_TRUE, waterfall_transform.data());
     glUniform1i(waterfall_shader["wfall"], 0);
     glUniform1i(waterfall_shader["cmap"], 1);
     glUniform1f(waterfall_shader["wrapPos"], 0.0f);
-    glUniform1f(waterfall_shader["histLen"], 1024.0f);
-    glUniform1f(waterfall_shader["wfallHeight"], (1.0f - SPECTRUM_HEIGHT) * WIN_HEIGHT);
+    glUniform1f(waterfall_shader["histLen"], hist_len);
+    glUniform1f(waterfall_shader["wfallHeight"], (1.0f - SPECTRUM_HEIGHT) * WIN_HEIGHT / rows);
+
+    // The rows are stacked vertically, each with its own spectrum and
+    // waterfall.
+    std::vector<Matrix<3, 3>> spectrum_transforms;
+    std::vector<Matrix<3, 3>> waterfall_transforms;
+    for (std::size_t r = 0; r < rows; r++) {
+        float row_height = 2.0f / rows;
+        auto row = translate(0.0f, 1.0f - (r + 0.5f) * row_height) * scale(1.0f, 0.5f * row_height);
+
+        spectrum_transforms.push_back(row * translate(0.0f, 1.0f - SPECTRUM_HEIGHT) * scale(1.0f, SPECTRUM_HEIGHT));
+        waterfall_transforms.push_back(row * translate(0.0f, -SPECTRUM_HEIGHT) * scale(1.0f, 1.0f - SPECTRUM_HEIGHT));
+    }
+
+    OverrunStats reported;
+    std::size_t reported_skipped = 0;
+    UdpStats reported_udp;
+    LatencyStats latency;
+    Uint32 last_report = SDL_GetTicks();
+    Uint32 last_latency = SDL_GetTicks();
+    std::vector<StageStats> reported_stages;
+    Uint32 last_stages = SDL_GetTicks();
 
     bool running = true;
     while (running) {
@@ -243,23 +713,136 @@ int main()
                 case SDL_QUIT:
                     running = false;
                     break;
+                case SDL_KEYDOWN: {
+                    if (ev.key.keysym.sym == SDLK_TAB) {
+                        selected = (selected + 1) % panels.size();
+                        std::cout << "View " << selected + 1 << " of " << panels.size() << std::endl;
+                        continue;
+                    }
+
+                    Panel& panel = panels[selected];
+                    FftSeq::Config config = panel.fft_seq->config();
+                    const float fft_rate = panel.fft_rate;
+                    const std::size_t window_idx = panel.window_idx;
+                    switch (ev.key.keysym.sym) {
+                        case SDLK_UP:
+                            config.fft_size = std::min(config.fft_size * 2, MAX_FFT_SIZE);
+                            break;
+                        case SDLK_DOWN:
+                            config.fft_size = std::max(config.fft_size / 2, min_fft_size);
+                            break;
+                        case SDLK_RIGHT:
+                            panel.fft_rate *= 2.0f;
+                            break;
+                        case SDLK_LEFT:
+                            panel.fft_rate /= 2.0f;
+                            break;
+                        case SDLK_w:
+                            panel.window_idx = (panel.window_idx + 1) % windows.size();
+                            config.window = windows[panel.window_idx];
+                            break;
+                        default:
+                            continue;
+                    }
+
+                    // The spacing follows the frame size and the FFT rate.
+                    int length = config.fft_size * config.pfb_taps;
+                    if (opts.welch) {
+                        config.spacing = -length / 2;
+                    } else {
+                        float samples_per_fft = rate / panel.fft_rate;
+                        config.spacing = std::max(1 - length, (int) (0.5f + samples_per_fft - length));
+                    }
+
+                    // A rejected change leaves the view as it was.
+                    try {
+                        panel.fft_seq->configure(config);
+                    } catch (const std::invalid_argument& e) {
+                        std::cerr << e.what() << std::endl;
+                        panel.fft_rate = fft_rate;
+                        panel.window_idx = window_idx;
+                        break;
+                    }
+
+                    std::cout << "FFT size " << config.fft_size << ", "
+                              << window_name(config.window) << " window, spacing "
+                              << config.spacing << std::endl;
+                    break;
+                }
             }
         }
 
-        if (fft_seq.has_next()) {
-            auto fft_line = fft_seq.next();
-            fft_seq.notify();
-
-            gen_fft_mipmap(fft_line, line, false);
+        // Take every frame that is ready, so that the workers are never
+        // held up by the frame rate of the display.
+        for (Panel& panel : panels) {
+            glBindTexture(GL_TEXTURE_1D_ARRAY, panel.texture);
+
+            while (panel.fft_seq->has_next()) {
+                const Frame& frame = panel.fft_seq->next();
+
+                // The frames after a reconfiguration have a new number
+                // of bins.
+                if (frame.bins != panel.bins) {
+                    rescale_waterfall(panel.bins, frame.bins, hist_len * lanes);
+                    panel.bins = frame.bins;
+                }
+
+                std::span<const float> power(frame.power);
+                for (std::size_t l = 0; l < lanes; l++) {
+                    std::span<const float> row = power.subspan(l * frame.bins, frame.bins);
+                    if (panel.mipmap) {
+                        gen_fft_mipmap(row, l * hist_len + panel.line);
+                    } else {
+                        upload_row(row, l * hist_len + panel.line);
+                    }
+                }
+
+                panel.wrap_pos = panel.line;
+                panel.line = (panel.line + 1) % hist_len;
+
+                if (opts.latency) {
+                    latency.add(frame.info, Stream::Clock::now());
+                }
+
+                panel.fft_seq->release();
+            }
+        }
 
-            spectrum_shader.use();
-            glUniform1f(spectrum_shader["wrapPos"], line);
+        if (opts.latency && SDL_GetTicks() - last_latency > 1000) {
+            print_latency(latency);
+            latency = LatencyStats();
+            last_latency = SDL_GetTicks();
+        }
 
-            waterfall_shader.use();
-            glUniform1f(waterfall_shader["wrapPos"], line);
+        if (pipeline && SDL_GetTicks() - last_stages > 1000) {
+            std::vector<StageStats> stats = pipeline->stats();
+            print_stages(stats, reported_stages);
+            reported_stages = stats;
+            last_stages = SDL_GetTicks();
+        }
 
-            line++;
-            line &= 0x3ff;
+        if (SDL_GetTicks() - last_report > 1000) {
+            if (buffered) {
+                OverrunStats stats = buffered->stats();
+                std::size_t skipped = 0;
+                for (const Panel& panel : panels) {
+                    skipped += panel.fft_seq->frames_skipped();
+                }
+                if (stats.samples_dropped != reported.samples_dropped || stats.stalls != reported.stalls
+                        || skipped != reported_skipped) {
+                    print_overruns(stats, buffered->capacity(), skipped);
+                    reported = stats;
+                    reported_skipped = skipped;
+                }
+            }
+            if (udp_buf) {
+                UdpStats stats = udp_buf->stats();
+                if (stats.lost != reported_udp.lost || stats.late != reported_udp.late) {
+                    print_packet_loss(stats);
+                    reported_udp = stats;
+                }
+            }
+            last_report = SDL_GetTicks();
         }
 
         glClearColor(1.0, 0.0, 0.0, 1.0);
@@ -267,11 +850,32 @@ int main()
 
         glBindVertexArray(vao);
 
-        spectrum_shader.use();
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        waterfall_shader.use();
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        for (std::size_t p = 0; p < panels.size(); p++) {
+            glBindTexture(GL_TEXTURE_1D_ARRAY, panels[p].texture);
+
+            // Every view has its own FFT size, which may have changed.
+            auto [db_lo, db_hi] = db_range(opts, rate, panels[p].fft_seq->fft_size());
+
+            for (std::size_t l = 0; l < lanes; l++) {
+                std::size_t r = p * lanes + l;
+
+                spectrum_shader.use();
+                glUniform1f(spectrum_shader["lo"], db_lo);
+                glUniform1f(spectrum_shader["hi"], db_hi);
+                glUniformMatrix3fv(spectrum_shader["transform"], 1, GL_TRUE, spectrum_transforms[r].data());
+                glUniform1f(spectrum_shader["wrapPos"], panels[p].wrap_pos);
+                glUniform1f(spectrum_shader["layerOffset"], l * hist_len);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+
+                waterfall_shader.use();
+                glUniform1f(waterfall_shader["lo"], db_lo);
+                glUniform1f(waterfall_shader["hi"], db_hi);
+                glUniformMatrix3fv(waterfall_shader["transform"], 1, GL_TRUE, waterfall_transforms[r].data());
+                glUniform1f(waterfall_shader["wrapPos"], panels[p].wrap_pos);
+                glUniform1f(waterfall_shader["layerOffset"], l * hist_len);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            }
+        }
 
         SDL_GL_SwapWindow(window);
     }
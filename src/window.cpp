@@ -0,0 +1,309 @@
+#include "window.h"
+#include "cache.h"
+
+#include <cmath>
+#include <numbers>
+#include <tuple>
+#include <stdexcept>
+#include <algorithm>
+#include <initializer_list>
+
+/**
+ * Sum of cosines with alternating signs, the form of the Hann, Hamming
+ * and Blackman families.
+ */
+static std::vector<float> cosine_sum(std::size_t N, std::initializer_list<double> a)
+{
+    using namespace std::numbers;
+
+    std::vector<float> win(N);
+    for (std::size_t n = 0; n < N; n++) {
+        double x = 2.0 * pi * n / N;
+        double w = 0.0;
+        double sign = 1.0;
+        std::size_t k = 0;
+        for (double ak : a) {
+            w += sign * ak * std::cos(k * x);
+            sign = -sign;
+            k++;
+        }
+        win[n] = w;
+    }
+
+    return win;
+}
+
+/**
+ * Modified Bessel function of the first kind, order zero.
+ */
+static double bessel_i0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; term > 1e-12 * sum; k++) {
+        double t = x / (2.0 * k);
+        term *= t * t;
+        sum += term;
+    }
+
+    return sum;
+}
+
+static std::vector<float> kaiser(std::size_t N, double beta)
+{
+    // The periodic window is the symmetric one of length N + 1 without
+    // its last sample.
+    std::vector<float> win(N);
+    const double norm = 1.0 / bessel_i0(beta);
+    for (std::size_t n = 0; n < N; n++) {
+        double x = 2.0 * n / N - 1.0;
+        win[n] = bessel_i0(beta * std::sqrt(std::max(0.0, 1.0 - x * x))) * norm;
+    }
+
+    return win;
+}
+
+/**
+ * Computes the first Slepian sequence as the eigenvector of the largest
+ * eigenvalue of the tridiagonal matrix that commutes with the time and
+ * band limiting operator.
+ */
+static std::vector<float> dpss(std::size_t N, double nw)
+{
+    using namespace std::numbers;
+
+    const std::size_t M = N + 1;
+    const double c = std::cos(2.0 * pi * nw / M);
+
+    std::vector<double> d(M);
+    std::vector<double> e(M, 0.0);
+    for (std::size_t n = 0; n < M; n++) {
+        double t = 0.5 * (double(M) - 1.0 - 2.0 * n);
+        d[n] = t * t * c;
+        e[n] = 0.5 * n * (M - n);
+    }
+
+    // Number of eigenvalues below x, from the signs of the pivots.
+    auto count_below = [&](double x) {
+        std::size_t count = 0;
+        double q = 1.0;
+        for (std::size_t n = 0; n < M; n++) {
+            q = d[n] - x - (n > 0 ? e[n] * e[n] / q : 0.0);
+            if (q == 0.0) {
+                q = -1e-300;
+            }
+            count += q < 0.0;
+        }
+        return count;
+    };
+
+    double lo = 0.0;
+    double hi = 0.0;
+    for (std::size_t n = 0; n < M; n++) {
+        double r = e[n] + (n + 1 < M ? e[n + 1] : 0.0);
+        lo = std::min(lo, d[n] - r);
+        hi = std::max(hi, d[n] + r);
+    }
+
+    for (int i = 0; i < 200 && lo < hi; i++) {
+        double mid = 0.5 * (lo + hi);
+        if (mid <= lo || mid >= hi) {
+            break;
+        }
+        if (count_below(mid) == M) {
+            hi = mid;
+        } else {
+            lo = mid;
+        }
+    }
+
+    // Inverse iteration shifted just above the largest eigenvalue, where
+    // the matrix is negative definite and needs no pivoting.
+    std::vector<double> x(M, 1.0);
+    std::vector<double> pivot(M);
+    for (int iter = 0; iter < 3; iter++) {
+        pivot[0] = d[0] - hi;
+        for (std::size_t n = 1; n < M; n++) {
+            double l = e[n] / pivot[n - 1];
+            pivot[n] = d[n] - hi - l * e[n];
+            x[n] -= l * x[n - 1];
+        }
+        x[M - 1] /= pivot[M - 1];
+        for (std::size_t n = M - 1; n-- > 0; ) {
+            x[n] = (x[n] - e[n + 1] * x[n + 1]) / pivot[n];
+        }
+
+        double peak = 0.0;
+        for (double v : x) {
+            peak = std::abs(v) > std::abs(peak) ? v : peak;
+        }
+        for (double& v : x) {
+            v /= peak;
+        }
+    }
+
+    return std::vector<float>(x.begin(), x.end() - 1);
+}
+
+WindowSpec parse_window(const std::string& name)
+{
+    std::size_t sep = name.find(':');
+    std::string type = name.substr(0, sep);
+
+    WindowSpec spec;
+    if (type == "rectangular") {
+        spec.type = WindowType::Rectangular;
+    } else if (type == "hann") {
+        spec.type = WindowType::Hann;
+    } else if (type == "hamming") {
+        spec.type = WindowType::Hamming;
+    } else if (type == "blackman") {
+        spec.type = WindowType::Blackman;
+    } else if (type == "blackman-harris") {
+        spec.type = WindowType::BlackmanHarris;
+    } else if (type == "nuttall") {
+        spec.type = WindowType::Nuttall;
+    } else if (type == "flattop") {
+        spec.type = WindowType::FlatTop;
+    } else if (type == "kaiser") {
+        spec = {WindowType::Kaiser, 8.6f};
+    } else if (type == "dpss") {
+        spec = {WindowType::Dpss, 3.0f};
+    } else {
+        throw std::invalid_argument("Unknown window: " + name);
+    }
+
+    if (sep != std::string::npos) {
+        if (spec.type != WindowType::Kaiser && spec.type != WindowType::Dpss) {
+            throw std::invalid_argument("The " + type + " window has no parameter");
+        }
+
+        std::string value = name.substr(sep + 1);
+        try {
+            std::size_t pos;
+            spec.param = std::stof(value, &pos);
+            if (pos != value.size()) {
+                throw std::invalid_argument(value);
+            }
+        } catch (const std::logic_error&) {
+            throw std::invalid_argument("Invalid window parameter: " + name);
+        }
+    }
+
+    if (spec.param < 0.0f || (spec.type == WindowType::Dpss && spec.param <= 0.0f)) {
+        throw std::invalid_argument("Invalid window parameter: " + name);
+    }
+
+    return spec;
+}
+
+std::string window_name(const WindowSpec& spec)
+{
+    switch (spec.type) {
+        case WindowType::Rectangular:
+            return "rectangular";
+        case WindowType::Hann:
+            return "hann";
+        case WindowType::Hamming:
+            return "hamming";
+        case WindowType::Blackman:
+            return "blackman";
+        case WindowType::BlackmanHarris:
+            return "blackman-harris";
+        case WindowType::Nuttall:
+            return "nuttall";
+        case WindowType::FlatTop:
+            return "flattop";
+        case WindowType::Kaiser:
+            return "kaiser:" + std::to_string(spec.param);
+        case WindowType::Dpss:
+            return "dpss:" + std::to_string(spec.param);
+    }
+
+    return "unknown";
+}
+
+std::vector<float> make_window(const WindowSpec& spec, std::size_t N)
+{
+    switch (spec.type) {
+        case WindowType::Rectangular:
+            return std::vector<float>(N, 1.0f);
+        case WindowType::Hann:
+            return cosine_sum(N, {0.5, 0.5});
+        case WindowType::Hamming:
+            return cosine_sum(N, {0.54, 0.46});
+        case WindowType::Blackman:
+            return cosine_sum(N, {0.42, 0.50, 0.08});
+        case WindowType::BlackmanHarris:
+            return cosine_sum(N, {0.35875, 0.48829, 0.14128, 0.01168});
+        case WindowType::Nuttall:
+            return cosine_sum(N, {0.355768, 0.487396, 0.144232, 0.012604});
+        case WindowType::FlatTop:
+            return cosine_sum(N, {0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368});
+        case WindowType::Kaiser:
+            return kaiser(N, spec.param);
+        case WindowType::Dpss:
+            return dpss(N, spec.param);
+    }
+
+    throw std::invalid_argument("Unknown window type");
+}
+
+std::vector<float> pfb_window(std::size_t size, std::size_t taps, const WindowSpec& spec)
+{
+    using namespace std::numbers;
+
+    std::size_t length = size * taps;
+    std::vector<float> win = make_window(spec, length);
+
+    if (taps == 1) {
+        return win;
+    }
+
+    const double center = 0.5 * (length - 1);
+    for (std::size_t n = 0; n < length; n++) {
+        double x = (n - center) / size;
+        win[n] *= (x == 0.0) ? 1.0 : std::sin(pi * x) / (pi * x);
+    }
+
+    return win;
+}
+
+WindowTable::WindowTable(std::vector<float> weights) : weights(std::move(weights))
+{
+    double sum = 0.0;
+    double power = 0.0;
+    for (float w : this->weights) {
+        sum += w;
+        power += double(w) * w;
+    }
+
+    const double N = this->weights.size();
+    coherent_gain = sum / N;
+    enbw = N * power / (sum * sum);
+}
+
+double WindowTable::sum() const
+{
+    return coherent_gain * weights.size();
+}
+
+double WindowTable::power() const
+{
+    return enbw * coherent_gain * coherent_gain * weights.size();
+}
+
+std::shared_ptr<const WindowTable> window_table(const WindowSpec& spec,
+        std::size_t size, std::size_t taps)
+{
+    using Key = std::tuple<WindowType, float, std::size_t, std::size_t>;
+
+    // Tables that nobody else holds are dropped once the cache grows
+    // past this many weights.
+    static SharedCache<Key, WindowTable> cache(std::size_t(1) << 24,
+            [](const WindowTable& table) { return table.weights.size(); });
+
+    return cache.get(Key{spec.type, spec.param, size, taps}, [&] {
+        return std::make_shared<const WindowTable>(pfb_window(size, taps, spec));
+    });
+}
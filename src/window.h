@@ -0,0 +1,101 @@
+#ifndef WFALL_WINDOW_H
+#define WFALL_WINDOW_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstddef>
+
+/**
+ * The window functions that a frame can be weighted with.
+ */
+enum class WindowType {
+    Rectangular,
+    Hann,
+    Hamming,
+    Blackman,
+    /** 4-term Blackman-Harris, -92 dB sidelobes. */
+    BlackmanHarris,
+    /** 4-term Nuttall with a continuous first derivative. */
+    Nuttall,
+    /** Flat-top, for measuring the amplitude of tones. */
+    FlatTop,
+    /** Kaiser with shape parameter beta. */
+    Kaiser,
+    /** First discrete prolate spheroidal sequence with half bandwidth NW. */
+    Dpss,
+};
+
+/**
+ * A window function and its parameter, if it has one.
+ */
+struct WindowSpec {
+    WindowType type = WindowType::Blackman;
+    /** Beta of the Kaiser window, NW of the DPSS window. */
+    float param = 0.0f;
+
+    bool operator==(const WindowSpec&) const = default;
+};
+
+/**
+ * Parses a window name, optionally followed by its parameter:
+ * "rectangular", "hann", "hamming", "blackman", "blackman-harris",
+ * "nuttall", "flattop", "kaiser[:BETA]" (default 8.6) or "dpss[:NW]"
+ * (default 3).
+ *
+ * Throws std::invalid_argument for unknown names or bad parameters.
+ */
+WindowSpec parse_window(const std::string& name);
+
+/**
+ * Returns the name of the window, in the form parse_window takes.
+ */
+std::string window_name(const WindowSpec& spec);
+
+/**
+ * Computes a window of length N. The windows are periodic (DFT-even),
+ * as suits spectral analysis.
+ */
+std::vector<float> make_window(const WindowSpec& spec, std::size_t N);
+
+/**
+ * Computes the prototype filter of a polyphase filter bank.
+ *
+ * The prototype is a sinc with its first zeros size samples from the
+ * center, spanning taps * size samples and tapered by the window. With
+ * taps = 1 it is just the window.
+ */
+std::vector<float> pfb_window(std::size_t size, std::size_t taps, const WindowSpec& spec);
+
+/**
+ * A window or filter bank prototype together with the gains needed to
+ * normalize spectra computed with it.
+ */
+struct WindowTable {
+    std::vector<float> weights;
+    /** Mean of the weights, the gain of a tone centered in a bin. */
+    double coherent_gain;
+    /** Equivalent noise bandwidth in bins of weights.size() points. */
+    double enbw;
+
+    WindowTable(std::vector<float> weights);
+
+    /** Sum of the weights. */
+    double sum() const;
+
+    /** Sum of the squared weights, the gain of white noise. */
+    double power() const;
+};
+
+/**
+ * Returns the prototype of a size point filter bank with taps taps
+ * tapered by spec, which with taps = 1 is the window itself.
+ *
+ * The tables are computed once per (spec, size, taps) and then shared
+ * read-only, so this is cheap for windows that have been used before.
+ * Safe to call from any thread.
+ */
+std::shared_ptr<const WindowTable> window_table(const WindowSpec& spec,
+        std::size_t size, std::size_t taps = 1);
+
+#endif /* WFALL_WINDOW_H */
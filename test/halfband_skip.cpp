@@ -0,0 +1,68 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <complex>
+
+#include "halfband.h"
+
+/**
+ * A tone that depends only on the position in the stream, so that
+ * skipped samples are really skipped.
+ */
+class ToneStream : public Stream {
+    std::size_t _pos = 0;
+
+public:
+    std::size_t lanes() const override { return 1; }
+
+    void read(OutSample* const* out, std::size_t count) override
+    {
+        for (std::size_t i = 0; i < count; i++, _pos++) {
+            out[0][i] = std::polar(1.0f, 0.01f * float(_pos % 100000));
+        }
+    }
+
+    void skip(std::size_t count) override { _pos += count; }
+};
+
+/**
+ * Skipping and then reading a cascade must give the same samples as
+ * reading straight through, and must not touch freed memory. A single
+ * sample is read first, so that the buffers of the cascade are still
+ * small and have to grow during the skip.
+ */
+int main()
+{
+    const std::size_t stages = 3;
+    const std::size_t before = 1;
+    const std::size_t skipped = 5000;
+    const std::size_t count = 4096;
+
+    ToneStream read_tone;
+    HalfbandStream read_cascade(read_tone, stages);
+    std::vector<Stream::OutSample> expected(before + skipped + count);
+    Stream::OutSample* ptr = expected.data();
+    read_cascade.read(&ptr, expected.size());
+
+    ToneStream skip_tone;
+    HalfbandStream skip_cascade(skip_tone, stages);
+    std::vector<Stream::OutSample> head(before);
+    ptr = head.data();
+    skip_cascade.read(&ptr, before);
+    skip_cascade.skip(skipped);
+    std::vector<Stream::OutSample> got(count);
+    ptr = got.data();
+    skip_cascade.read(&ptr, count);
+
+    float error = 0.0f;
+    for (std::size_t i = 0; i < count; i++) {
+        error = std::max(error, std::abs(got[i] - expected[before + skipped + i]));
+    }
+
+    if (error > 1e-4f) {
+        std::cerr << "halfband_skip: read after skip is off by " << error << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,257 @@
+#include <iostream>
+#include <istream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <stdexcept>
+#include <functional>
+#include <cstdint>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "net.h"
+
+/** Payload bytes per datagram in the UDP test. */
+static const std::size_t PAYLOAD = 16;
+
+/**
+ * Opens a socket of the given type bound to a free loopback port, and
+ * returns it with the port.
+ */
+static std::pair<int, uint16_t> loopback_socket(int type)
+{
+    int fd = socket(AF_INET, type, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        throw std::runtime_error("Could not bind a loopback socket");
+    }
+
+    socklen_t len = sizeof(addr);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+    return {fd, ntohs(addr.sin_port)};
+}
+
+/**
+ * Accepts one connection on fd, sends header, reads command_bytes bytes
+ * into commands and then sends samples.
+ */
+static void serve(int fd, std::string header, std::size_t command_bytes,
+        std::vector<unsigned char>& commands, std::vector<unsigned char> samples)
+{
+    int conn = accept(fd, nullptr, nullptr);
+    if (conn < 0) {
+        return;
+    }
+
+    send(conn, header.data(), header.size(), MSG_NOSIGNAL);
+
+    commands.resize(command_bytes);
+    std::size_t got = 0;
+    while (got < command_bytes) {
+        ssize_t n = recv(conn, commands.data() + got, command_bytes - got, 0);
+        if (n <= 0) {
+            break;
+        }
+        got += n;
+    }
+    commands.resize(got);
+
+    send(conn, samples.data(), samples.size(), MSG_NOSIGNAL);
+    close(conn);
+}
+
+/**
+ * An rtl_tcp client must read the header, send each command as one byte
+ * and a big endian 32 bit parameter, and then read the samples until the
+ * server closes the connection.
+ */
+static bool test_rtl_tcp()
+{
+    auto [fd, port] = loopback_socket(SOCK_STREAM);
+    listen(fd, 1);
+
+    // "RTL0", tuner type 5 (R820T) and 29 gain steps.
+    const std::string header("RTL0\0\0\0\x05\0\0\0\x1d", 12);
+    const std::vector<unsigned char> expected = {
+        0x01, 0x05, 0xf5, 0xe1, 0x00, // Frequency 100000000
+        0x02, 0x00, 0x1f, 0x40, 0x00, // SampleRate 2048000
+        0x03, 0x00, 0x00, 0x00, 0x01, // GainMode manual
+        0x04, 0x00, 0x00, 0x01, 0x29, // Gain 29.7 dB in tenths
+        0x03, 0x00, 0x00, 0x00, 0x00, // GainMode automatic
+    };
+    std::vector<unsigned char> samples(100000);
+    for (std::size_t i = 0; i < samples.size(); i++) {
+        samples[i] = static_cast<unsigned char>(i * 7);
+    }
+
+    std::vector<unsigned char> commands;
+    std::thread server(serve, fd, header, expected.size(), std::ref(commands), samples);
+
+    bool ok = true;
+    std::vector<unsigned char> got;
+    try {
+        RtlTcpBuf buf("127.0.0.1:" + std::to_string(port));
+        if (buf.tuner() != 5 || buf.gain_count() != 29) {
+            std::cerr << "net_loopback: header read as tuner " << buf.tuner()
+                    << " with " << buf.gain_count() << " gains" << std::endl;
+            ok = false;
+        }
+
+        buf.command(RtlCommand::Frequency, 100000000);
+        buf.command(RtlCommand::SampleRate, 2048000);
+        buf.gain(29.7f);
+        buf.gain(std::nullopt);
+
+        std::istream in(&buf);
+        std::vector<char> chunk(777);
+        while (in.read(chunk.data(), chunk.size()) || in.gcount() > 0) {
+            got.insert(got.end(), chunk.begin(), chunk.begin() + in.gcount());
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "net_loopback: " << e.what() << std::endl;
+        ok = false;
+    }
+
+    server.join();
+    close(fd);
+
+    if (commands != expected) {
+        std::cerr << "net_loopback: the server received the wrong commands" << std::endl;
+        ok = false;
+    }
+    if (got != samples) {
+        std::cerr << "net_loopback: read " << got.size() << " of " << samples.size()
+                << " samples, or the wrong ones" << std::endl;
+        ok = false;
+    }
+
+    return ok;
+}
+
+/**
+ * A server that does not send the rtl_tcp header must be refused.
+ */
+static bool test_rtl_tcp_header()
+{
+    auto [fd, port] = loopback_socket(SOCK_STREAM);
+    listen(fd, 1);
+
+    std::vector<unsigned char> commands;
+    std::thread server(serve, fd, std::string("HTTP/1.1 200"), 0, std::ref(commands),
+            std::vector<unsigned char>());
+
+    bool ok = false;
+    try {
+        RtlTcpBuf buf("127.0.0.1:" + std::to_string(port));
+    } catch (const std::runtime_error&) {
+        ok = true;
+    }
+
+    server.join();
+    close(fd);
+
+    if (!ok) {
+        std::cerr << "net_loopback: accepted a server without the rtl_tcp header" << std::endl;
+    }
+    return ok;
+}
+
+/**
+ * Sends a sequenced datagram with the given payload to port.
+ */
+static void send_datagram(int fd, uint16_t port, uint32_t seq, const std::vector<char>& payload)
+{
+    std::vector<char> msg = {
+        static_cast<char>(seq), static_cast<char>(seq >> 8),
+        static_cast<char>(seq >> 16), static_cast<char>(seq >> 24),
+    };
+    msg.insert(msg.end(), payload.begin(), payload.end());
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    sendto(fd, msg.data(), msg.size(), 0, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+}
+
+/**
+ * A sequenced UdpBuf must fill a gap in the sequence with zeros, drop
+ * late and duplicate datagrams, take a large jump as a restart, cut off
+ * datagrams that are too long, and count all of it.
+ */
+static bool test_udp_sequence()
+{
+    // Free a port for the UdpBuf to bind.
+    auto [probe, port] = loopback_socket(SOCK_DGRAM);
+    close(probe);
+    UdpBuf buf("127.0.0.1:" + std::to_string(port), true, 4, 4 + PAYLOAD);
+
+    auto data = [](int k, std::size_t size = PAYLOAD) {
+        std::vector<char> d(size);
+        for (std::size_t i = 0; i < size; i++) {
+            d[i] = static_cast<char>(k * PAYLOAD + i + 1);
+        }
+        return d;
+    };
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    send_datagram(fd, port, 0, data(0));
+    send_datagram(fd, port, 1, data(1));
+    send_datagram(fd, port, 3, data(3));                    // 2 is lost
+    send_datagram(fd, port, 2, data(2));                    // late
+    send_datagram(fd, port, 3, data(3));                    // duplicate
+    send_datagram(fd, port, 4, data(4));
+    send_datagram(fd, port, 100000, data(5));               // restarted sender
+    send_datagram(fd, port, 100001, data(6, 2 * PAYLOAD));  // truncated
+    close(fd);
+
+    std::vector<char> expected;
+    for (int k : {0, 1, -1, 3, 4, 5, 6}) {
+        std::vector<char> d = k < 0 ? std::vector<char>(PAYLOAD) : data(k);
+        expected.insert(expected.end(), d.begin(), d.end());
+    }
+
+    std::istream in(&buf);
+    std::vector<char> got(expected.size());
+    in.read(got.data(), got.size());
+
+    bool ok = true;
+    if (std::size_t(in.gcount()) != got.size() || got != expected) {
+        std::cerr << "net_loopback: the datagrams were not put in sequence" << std::endl;
+        ok = false;
+    }
+
+    UdpStats stats = buf.stats();
+    if (stats.datagrams != 8 || stats.lost != 1 || stats.late != 2 || stats.truncated != 1) {
+        std::cerr << "net_loopback: counted " << stats.datagrams << " datagrams, "
+                << stats.lost << " lost, " << stats.late << " late and "
+                << stats.truncated << " truncated" << std::endl;
+        ok = false;
+    }
+
+    return ok;
+}
+
+/**
+ * Runs an rtl_tcp server and a UDP sender on the loopback interface.
+ */
+int main()
+{
+    // A buffer that loses data waits for more forever, so the test is
+    // killed instead.
+    alarm(10);
+
+    bool ok = test_rtl_tcp();
+    ok &= test_rtl_tcp_header();
+    ok &= test_udp_sequence();
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <complex>
+#include <numbers>
+
+#include "resample.h"
+
+/**
+ * A complex tone at a fixed frequency.
+ */
+class ToneStream : public Stream {
+    double _step;
+    uint64_t _pos = 0;
+
+public:
+    ToneStream(double rate, double freq) : _step(2.0 * std::numbers::pi * freq / rate) {}
+
+    std::size_t lanes() const override { return 1; }
+
+    void read(OutSample* const* out, std::size_t count) override
+    {
+        for (std::size_t i = 0; i < count; i++, _pos++) {
+            out[0][i] = OutSample(std::polar(1.0, _step * double(_pos)));
+        }
+    }
+
+    void skip(std::size_t count) override { _pos += count; }
+};
+
+/**
+ * Resamples a tone at freq and returns the amplitude of the output at
+ * alias, where the tone ends up at the output rate.
+ */
+static double amplitude(double in_rate, double out_rate, double freq, double alias)
+{
+    const std::size_t settle = 1000;
+    const std::size_t count = 4800;
+
+    ToneStream tone(in_rate, freq);
+    ResampleStream resampler(tone, in_rate, out_rate);
+    resampler.skip(settle);
+
+    std::vector<Stream::OutSample> out(count);
+    Stream::OutSample* ptr = out.data();
+    resampler.read(&ptr, count);
+
+    std::complex<double> sum = 0.0;
+    for (std::size_t n = 0; n < count; n++) {
+        double phase = -2.0 * std::numbers::pi * alias * double(settle + n) / out_rate;
+        sum += std::complex<double>(out[n]) * std::polar(1.0, phase);
+    }
+    return std::abs(sum) / double(count);
+}
+
+/**
+ * Going from 2.048 MS/s to 48 kS/s (up 3, down 128) must pass a tone in
+ * the band and reject the tones that fold onto it from beyond the
+ * output Nyquist frequency: one at the output rate, which lands on DC,
+ * and one at 0.75 times the output rate.
+ */
+int main()
+{
+    const double in_rate = 2048000.0;
+    const double out_rate = 48000.0;
+
+    double pass = amplitude(in_rate, out_rate, 6000.0, 6000.0);
+    if (std::abs(pass - 1.0) > 0.01) {
+        std::cerr << "resample_rejection: passband gain is " << pass << std::endl;
+        return 1;
+    }
+
+    const double stop[][2] = {{48000.0, 0.0}, {36000.0, -12000.0}};
+    for (const auto& [freq, alias] : stop) {
+        double db = 20.0 * std::log10(amplitude(in_rate, out_rate, freq, alias) / pass);
+        if (db > -60.0) {
+            std::cerr << "resample_rejection: " << freq << " Hz folds to " << alias
+                    << " Hz only " << -db << " dB down" << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}